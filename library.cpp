@@ -1,13 +1,52 @@
 #include <iostream>
 #include <vector>
-#include <map>
 #include <unordered_map>
+#include <map>
 #include <string>
 #include <fstream>
 #include <algorithm>
 #include <iomanip>
 #include <stdexcept>
 #include <limits>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <charconv>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstring>
+#include <shared_mutex>
+#include <functional>
+#include <future>
+#include <deque>
+#include <queue>
+#include <memory>
+#include <random>
+#include <cctype>
+#include <ctime>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <csignal>
+#include <cerrno>
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define LIBRARY_X86_SIMD 1
+#endif
 
 // Forward declarations
 class Book;
@@ -15,50 +54,587 @@ class User;
 class Admin;
 class LibrarySystem;
 
+// Read-only view of a whole file, memory-mapped where the platform allows it
+class MappedFile {
+private:
+    const char* data;
+    size_t length;
+    bool mapped;
+    std::string fallback;
+
+public:
+    MappedFile() : data(nullptr), length(0), mapped(false) {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    // Returns false if the file does not exist or cannot be read
+    bool open(const std::string& path) {
+        close();
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        length = static_cast<size_t>(st.st_size);
+        if (length > 0) {
+            void* addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                ::close(fd);
+                length = 0;
+                return false;
+            }
+            madvise(addr, length, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(addr);
+            mapped = true;
+        }
+        ::close(fd);
+        return true;
+#else
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) return false;
+        fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = fallback.data();
+        length = fallback.size();
+        return true;
+#endif
+    }
+
+    void close() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (mapped) munmap(const_cast<char*>(data), length);
+#endif
+        fallback.clear();
+        data = nullptr;
+        length = 0;
+        mapped = false;
+    }
+
+    std::string_view view() const { return std::string_view(data, length); }
+};
+
+// Parsing helpers for the comma-separated data files
+
+// Split a line on a separator into at most maxFields views.
+// Returns the total number of fields in the line, which may exceed maxFields.
+inline size_t splitFields(std::string_view line, char sep, std::string_view* out, size_t maxFields) {
+    size_t count = 0;
+    size_t start = 0;
+    while (true) {
+        size_t pos = line.find(sep, start);
+        std::string_view field = line.substr(start, pos == std::string_view::npos ? std::string_view::npos : pos - start);
+        if (count < maxFields) out[count] = field;
+        ++count;
+        if (pos == std::string_view::npos) break;
+        start = pos + 1;
+    }
+    return count;
+}
+
+// Parse a whole field as an integer; fails on empty fields or trailing junk
+template <typename Int>
+inline bool parseInt(std::string_view field, Int& value) {
+    const char* first = field.data();
+    const char* last = first + field.size();
+    auto result = std::from_chars(first, last, value);
+    return result.ec == std::errc() && result.ptr == last && first != last;
+}
+
+// True if a text field can be stored as-is: the data files are
+// comma-separated and the journal is line-based, so commas and control
+// characters (line breaks included) are refused
+inline bool isStorableField(std::string_view field) {
+    for (char c : field) {
+        if (c == ',' || static_cast<unsigned char>(c) < 0x20 || c == 0x7f) return false;
+    }
+    return true;
+}
+
+// Append the decimal form of an integer without a temporary string
+template <typename Int>
+inline void appendInt(std::string& out, Int value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr);
+}
+
+// Invoke fn(lineNumber, line) for every non-empty line, tolerating CRLF endings
+template <typename Fn>
+void forEachLine(std::string_view text, Fn fn) {
+    size_t lineNumber = 0;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string_view::npos) end = text.size();
+        std::string_view line = text.substr(start, end - start);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        ++lineNumber;
+        if (!line.empty()) fn(lineNumber, line);
+        start = end + 1;
+    }
+}
+
+// Split text into at most `pieces` parts of similar size, each ending just
+// after a newline (except the last), so no line straddles two parts
+inline std::vector<std::string_view> splitAtLines(std::string_view text, size_t pieces) {
+    std::vector<std::string_view> parts;
+    size_t target = text.size() / std::max<size_t>(1, pieces) + 1;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.size();
+        if (text.size() - start > target) {
+            size_t newline = text.find('\n', start + target - 1);
+            if (newline != std::string_view::npos) end = newline + 1;
+        }
+        parts.push_back(text.substr(start, end - start));
+        start = end;
+    }
+    return parts;
+}
+
+// 32-bit FNV-1a checksum, used to detect torn or corrupted records
+inline uint32_t checksum32(std::string_view data, uint32_t hash = 2166136261u) {
+    for (char c : data) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Flush a stdio stream all the way to stable storage
+inline bool syncFile(std::FILE* file) {
+    if (std::fflush(file) != 0) return false;
+#if defined(__unix__) || defined(__APPLE__)
+    return fsync(fileno(file)) == 0;
+#else
+    return true;
+#endif
+}
+
+// Replace a file's contents atomically: write a temp file, sync it, rename over the target
+inline bool writeFileAtomically(const std::string& path, std::string_view contents) {
+    std::string tempPath = path + ".tmp";
+    std::FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file) return false;
+    bool ok = std::fwrite(contents.data(), 1, contents.size(), file) == contents.size() && syncFile(file);
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Cut a file back to its first `size` bytes and sync it
+inline bool truncateFile(const std::string& path, size_t size) {
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(path.c_str(), O_WRONLY);
+    if (fd < 0) return false;
+    bool ok = ftruncate(fd, static_cast<off_t>(size)) == 0 && fsync(fd) == 0;
+    return ::close(fd) == 0 && ok;
+#else
+    std::ifstream in(path, std::ios::binary);
+    std::string kept(size, '\0');
+    if (!in.read(&kept[0], static_cast<std::streamsize>(size))) return false;
+    in.close();
+    return writeFileAtomically(path, kept);
+#endif
+}
+
+// Append-only write-ahead journal with group commit.
+// Records are buffered by append() and written by a background thread that
+// batches everything pending into one write + fsync. A failed write is cut
+// back off the file and the journal stays failed from then on: later records
+// are dropped rather than written after a gap.
+class Journal {
+private:
+    std::string path;
+    std::FILE* file;
+    std::string pending;
+    uint64_t nextLsn;
+    uint64_t durableLsn;  // every record up to here has been written or dropped
+    uint64_t goodLsn;     // every record up to here is on disk
+    uint64_t syncCount;   // batches written and fsynced
+    size_t bytesOnDisk;
+    bool stopping;
+    std::atomic<bool> failed;  // checked by every mutation, so readable without the mutex
+    std::chrono::microseconds commitDelay;
+    mutable std::mutex mtx;
+    std::condition_variable workReady;
+    std::condition_variable durable;
+    std::thread flusher;
+
+    // Start flushing early once this much is buffered
+    static const size_t FLUSH_THRESHOLD = 256 * 1024;
+
+    void flushLoop() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true) {
+            workReady.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty() && stopping) break;
+
+            // Give concurrent committers a moment to join this batch
+            if (!stopping && pending.size() < FLUSH_THRESHOLD) {
+                workReady.wait_for(lock, commitDelay,
+                                   [this] { return stopping || pending.size() >= FLUSH_THRESHOLD; });
+            }
+
+            std::string batch;
+            batch.swap(pending);
+            uint64_t batchLsn = nextLsn - 1;
+            bool skip = failed;
+            lock.unlock();
+
+            bool ok = !skip && std::fwrite(batch.data(), 1, batch.size(), file) == batch.size() && syncFile(file);
+            // Part of the batch may have reached the disk anyway
+            if (!ok && !skip) truncateFile(path, bytesOnDisk);
+
+            lock.lock();
+            if (ok) {
+                bytesOnDisk += batch.size();
+                goodLsn = batchLsn;
+                ++syncCount;
+            } else {
+                failed = true;
+            }
+            durableLsn = batchLsn;
+            durable.notify_all();
+        }
+    }
+
+public:
+    Journal() : file(nullptr), nextLsn(1), durableLsn(0), goodLsn(0), syncCount(0), bytesOnDisk(0),
+                stopping(false), failed(false), commitDelay(200) {}
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    ~Journal() {
+        close();
+    }
+
+    // Open (or create) the journal for appending and start the flusher.
+    // A journal that has failed stays failed across reopening.
+    bool open(const std::string& journalPath) {
+        close();
+        std::FILE* opened = std::fopen(journalPath.c_str(), "ab");
+        if (!opened) return false;
+        // Batches go straight to the file, so a failed one can be cut off whole
+        std::setvbuf(opened, nullptr, _IONBF, 0);
+        std::fseek(opened, 0, SEEK_END);
+        size_t existing = static_cast<size_t>(std::ftell(opened));
+        {
+            // Committers may be reading these while a checkpoint reopens the journal
+            std::lock_guard<std::mutex> lock(mtx);
+            path = journalPath;
+            file = opened;
+            bytesOnDisk = existing;
+            stopping = false;
+        }
+        flusher = std::thread(&Journal::flushLoop, this);
+        return true;
+    }
+
+    // Flush everything buffered, stop the flusher and close the file
+    void close() {
+        if (!file) return;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        workReady.notify_all();
+        flusher.join();
+        std::FILE* closing;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            closing = file;
+            file = nullptr;
+        }
+        durable.notify_all();
+        std::fclose(closing);
+    }
+
+    // Locked: the server thread asks while a checkpoint may be reopening the file
+    bool isOpen() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return file != nullptr;
+    }
+
+    // Buffer one record and return its log sequence number
+    uint64_t append(std::string_view payload) {
+        char suffix[16];
+        std::snprintf(suffix, sizeof(suffix), "#%08x\n", checksum32(payload));
+        std::lock_guard<std::mutex> lock(mtx);
+        pending.append(payload.data(), payload.size());
+        pending.append(suffix);
+        uint64_t lsn = nextLsn++;
+        workReady.notify_one();
+        return lsn;
+    }
+
+    // Block until the record with this LSN has been fsynced; false if it
+    // could not be written
+    bool waitDurable(uint64_t lsn) {
+        std::unique_lock<std::mutex> lock(mtx);
+        durable.wait(lock, [this, lsn] { return durableLsn >= lsn || !file; });
+        return goodLsn >= lsn;
+    }
+
+    bool hasFailed() const { return failed.load(); }
+
+    // Highest LSN up to which every record is on disk
+    uint64_t durableThrough() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return goodLsn;
+    }
+
+    // Make every appended record durable
+    bool sync() {
+        uint64_t lsn;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            lsn = nextLsn - 1;
+        }
+        return waitDurable(lsn);
+    }
+
+    size_t sizeBytes() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return bytesOnDisk + pending.size();
+    }
+
+    // Records appended and fsyncs issued since the process started; their
+    // ratio is how many commits each fsync carried
+    std::pair<uint64_t, uint64_t> commitCounts() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return std::make_pair(nextLsn - 1, syncCount);
+    }
+
+    void setCommitDelay(std::chrono::microseconds delay) {
+        std::lock_guard<std::mutex> lock(mtx);
+        commitDelay = delay;
+    }
+
+    // Invoke fn(payload) for each intact record of a journal file, in order.
+    // Replay stops at the first torn or corrupted record. Returns records
+    // replayed; `intactBytes` is set to the length of the records before it.
+    template <typename Fn>
+    static size_t replay(const std::string& journalPath, Fn fn, size_t* intactBytes = nullptr) {
+        MappedFile mapped;
+        if (intactBytes) *intactBytes = 0;
+        if (!mapped.open(journalPath)) return 0;
+        std::string_view text = mapped.view();
+
+        size_t replayed = 0;
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t end = text.find('\n', start);
+            if (end == std::string_view::npos) break;  // torn final record
+            std::string_view record = text.substr(start, end - start);
+            start = end + 1;
+
+            size_t hashPos = record.rfind('#');
+            if (hashPos == std::string_view::npos || record.size() - hashPos != 9) break;
+            std::string_view payload = record.substr(0, hashPos);
+            uint32_t stored = 0;
+            std::string_view hex = record.substr(hashPos + 1);
+            auto result = std::from_chars(hex.data(), hex.data() + hex.size(), stored, 16);
+            if (result.ec != std::errc() || stored != checksum32(payload)) break;
+
+            fn(payload);
+            ++replayed;
+            if (intactBytes) *intactBytes = start;
+        }
+        return replayed;
+    }
+};
+
+// Process-wide pool of interned, immutable strings. Each distinct string is
+// stored once in arena chunks that never move, so a handle is one pointer and
+// reading through it takes no lock. Strings are never freed: editing a field
+// interns the new value and leaves the old one in the arena.
+class StringPool {
+private:
+    static const size_t CHUNK_SIZE = 1 << 20;
+    static const size_t ENTRY_HEADER = 8;  // uint32 length, uint32 hash
+
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char* current;
+    size_t currentLeft;
+    size_t arenaBytes;
+    // Open-addressing table of entries, power-of-two size, at most 70% full
+    std::vector<const char*> table;
+    size_t entryCount;
+    mutable std::mutex mtx;
+
+    static uint32_t lengthOf(const char* entry) {
+        uint32_t length;
+        std::memcpy(&length, entry, sizeof(length));
+        return length;
+    }
+
+    static uint32_t hashOf(const char* entry) {
+        uint32_t hash;
+        std::memcpy(&hash, entry + 4, sizeof(hash));
+        return hash;
+    }
+
+    const char* allocate(std::string_view s, uint32_t hash) {
+        size_t need = (ENTRY_HEADER + s.size() + 3) & ~size_t(3);
+        char* entry;
+        if (need > CHUNK_SIZE / 4) {
+            // Large strings get a chunk of their own
+            chunks.emplace_back(new char[need]);
+            entry = chunks.back().get();
+        } else {
+            if (need > currentLeft) {
+                chunks.emplace_back(new char[CHUNK_SIZE]);
+                current = chunks.back().get();
+                currentLeft = CHUNK_SIZE;
+            }
+            entry = current;
+            current += need;
+            currentLeft -= need;
+        }
+        arenaBytes += need;
+        uint32_t length = static_cast<uint32_t>(s.size());
+        std::memcpy(entry, &length, sizeof(length));
+        std::memcpy(entry + 4, &hash, sizeof(hash));
+        std::memcpy(entry + ENTRY_HEADER, s.data(), s.size());
+        return entry;
+    }
+
+    void grow() {
+        std::vector<const char*> bigger(table.size() * 2, nullptr);
+        size_t mask = bigger.size() - 1;
+        for (const char* entry : table) {
+            if (!entry) continue;
+            size_t i = hashOf(entry) & mask;
+            while (bigger[i]) i = (i + 1) & mask;
+            bigger[i] = entry;
+        }
+        table.swap(bigger);
+    }
+
+    StringPool() : current(nullptr), currentLeft(0), arenaBytes(0), table(1024, nullptr), entryCount(0) {}
+
+public:
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    static StringPool& instance() {
+        static StringPool pool;
+        return pool;
+    }
+
+    // Handle of the single shared copy of s; the empty string is nullptr
+    const char* intern(std::string_view s) {
+        if (s.empty()) return nullptr;
+        uint32_t hash = checksum32(s);
+        std::lock_guard<std::mutex> lock(mtx);
+        if ((entryCount + 1) * 10 > table.size() * 7) grow();
+        size_t mask = table.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            const char* entry = table[i];
+            if (!entry) {
+                table[i] = allocate(s, hash);
+                ++entryCount;
+                return table[i];
+            }
+            if (hashOf(entry) == hash && view(entry) == s) return entry;
+        }
+    }
+
+    static std::string_view view(const char* entry) {
+        return entry ? std::string_view(entry + ENTRY_HEADER, lengthOf(entry)) : std::string_view();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return entryCount;
+    }
+
+    // Bytes held by the arena and the lookup table
+    size_t memoryUsage() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return chunks.size() * sizeof(void*) + (arenaBytes + currentLeft) + table.size() * sizeof(const char*);
+    }
+};
+
+// Compact handle to a string in the StringPool; copying it copies one pointer
+class InternedString {
+private:
+    const char* entry;
+
+public:
+    InternedString() : entry(nullptr) {}
+    explicit InternedString(std::string_view s) : entry(StringPool::instance().intern(s)) {}
+
+    std::string_view view() const { return StringPool::view(entry); }
+    bool empty() const { return entry == nullptr; }
+
+    // Each distinct text is stored once, so equal text means equal handles
+    bool operator==(const InternedString& other) const { return entry == other.entry; }
+    bool operator!=(const InternedString& other) const { return entry != other.entry; }
+};
+
 // Book class
 class Book {
 private:
     int bookId;
-    std::string title;
-    std::string author;
-    std::string isbn;
+    // Text fields are interned: authors in particular repeat across many books
+    InternedString title;
+    InternedString author;
+    InternedString isbn;
     bool isIssued;
     int issuedToUserId;
 
 public:
     // Default constructor
-    Book() : bookId(0), title(""), author(""), isbn(""), isIssued(false), issuedToUserId(-1) {}
+    Book() : bookId(0), isIssued(false), issuedToUserId(-1) {}
     
     // Parameterized constructor
-    Book(int id, const std::string& t, const std::string& a, const std::string& i) 
+    Book(int id, std::string_view t, std::string_view a, std::string_view i)
         : bookId(id), title(t), author(a), isbn(i), isIssued(false), issuedToUserId(-1) {}
     
     // Constructor overloading
-    Book(int id, const std::string& t, const std::string& a, const std::string& i, bool issued, int userId)
+    Book(int id, std::string_view t, std::string_view a, std::string_view i, bool issued, int userId)
         : bookId(id), title(t), author(a), isbn(i), isIssued(issued), issuedToUserId(userId) {}
 
-    // Getters
+    // From already-interned fields, without touching the pool
+    Book(int id, InternedString t, InternedString a, InternedString i, bool issued, int userId)
+        : bookId(id), title(t), author(a), isbn(i), isIssued(issued), issuedToUserId(userId) {}
+
+    // Getters; the views stay valid for the life of the process
     int getBookId() const { return bookId; }
-    std::string getTitle() const { return title; }
-    std::string getAuthor() const { return author; }
-    std::string getIsbn() const { return isbn; }
+    std::string_view getTitle() const { return title.view(); }
+    std::string_view getAuthor() const { return author.view(); }
+    std::string_view getIsbn() const { return isbn.view(); }
+    InternedString getTitleHandle() const { return title; }
+    InternedString getAuthorHandle() const { return author; }
+    InternedString getIsbnHandle() const { return isbn; }
     bool getIsIssued() const { return isIssued; }
     int getIssuedToUserId() const { return issuedToUserId; }
 
     // Setters
     void setBookId(int id) { bookId = id; }
-    void setTitle(const std::string& t) { title = t; }
-    void setAuthor(const std::string& a) { author = a; }
-    void setIsbn(const std::string& i) { isbn = i; }
+    void setTitle(std::string_view t) { title = InternedString(t); }
+    void setAuthor(std::string_view a) { author = InternedString(a); }
+    void setIsbn(std::string_view i) { isbn = InternedString(i); }
     void setIsIssued(bool issued) { isIssued = issued; }
     void setIssuedToUserId(int userId) { issuedToUserId = userId; }
 
     // Virtual display function for polymorphism
     virtual void display() const {
         std::cout << std::left << std::setw(5) << bookId 
-                  << std::setw(25) << title 
-                  << std::setw(20) << author 
-                  << std::setw(15) << isbn 
+                  << std::setw(25) << title.view()
+                  << std::setw(20) << author.view()
+                  << std::setw(15) << isbn.view()
                   << std::setw(10) << (isIssued ? "Issued" : "Available");
         if (isIssued) {
             std::cout << std::setw(10) << issuedToUserId;
@@ -68,35 +644,232 @@ public:
 
     // Function to save book data to file
     std::string toFileString() const {
-        return std::to_string(bookId) + "," + title + "," + author + "," + isbn + "," + 
-               std::to_string(isIssued) + "," + std::to_string(issuedToUserId);
+        std::string row;
+        appendFileString(row);
+        return row;
     }
 
-    // Function to load book data from file string
-    void fromFileString(const std::string& data) {
-        size_t pos = 0;
-        std::string token;
-        std::vector<std::string> tokens;
-        std::string temp = data;
-        
-        while ((pos = temp.find(',')) != std::string::npos) {
-            token = temp.substr(0, pos);
-            tokens.push_back(token);
-            temp.erase(0, pos + 1);
+    // Append the books.txt row (without newline) to a reused buffer
+    void appendFileString(std::string& out) const {
+        appendInt(out, bookId);
+        out += ',';
+        out += title.view();
+        out += ',';
+        out += author.view();
+        out += ',';
+        out += isbn.view();
+        out += ',';
+        out += isIssued ? '1' : '0';
+        out += ',';
+        appendInt(out, issuedToUserId);
+    }
+
+    // Function to load book data from file string; returns false if malformed
+    bool fromFileString(std::string_view data) {
+        std::string_view tokens[6];
+        if (splitFields(data, ',', tokens, 6) < 6) return false;
+
+        int id, issued, userId;
+        if (!parseInt(tokens[0], id) || !parseInt(tokens[4], issued) || !parseInt(tokens[5], userId)) {
+            return false;
+        }
+
+        bookId = id;
+        title = InternedString(tokens[1]);
+        author = InternedString(tokens[2]);
+        isbn = InternedString(tokens[3]);
+        isIssued = issued != 0;
+        issuedToUserId = userId;
+        return true;
+    }
+};
+
+// SHA-256 (FIPS 180-4), used for password hashing
+class Sha256 {
+private:
+    uint32_t state[8];
+    unsigned char block[64];
+    size_t blockLength;
+    uint64_t totalLength;
+
+    static uint32_t rotr(uint32_t x, unsigned n) { return (x >> n) | (x << (32 - n)); }
+
+    void compress(const unsigned char* chunk) {
+        static const uint32_t K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (uint32_t(chunk[4 * i]) << 24) | (uint32_t(chunk[4 * i + 1]) << 16) |
+                   (uint32_t(chunk[4 * i + 2]) << 8) | uint32_t(chunk[4 * i + 3]);
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+
+public:
+    static const size_t DIGEST_SIZE = 32;
+
+    Sha256() : state{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19},
+               blockLength(0), totalLength(0) {}
+
+    void update(const void* data, size_t length) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        totalLength += length;
+        while (length > 0) {
+            size_t take = std::min(length, sizeof(block) - blockLength);
+            std::memcpy(block + blockLength, bytes, take);
+            blockLength += take;
+            bytes += take;
+            length -= take;
+            if (blockLength == sizeof(block)) {
+                compress(block);
+                blockLength = 0;
+            }
         }
-        tokens.push_back(temp);
+    }
 
-        if (tokens.size() >= 6) {
-            bookId = std::stoi(tokens[0]);
-            title = tokens[1];
-            author = tokens[2];
-            isbn = tokens[3];
-            isIssued = std::stoi(tokens[4]);
-            issuedToUserId = std::stoi(tokens[5]);
+    void finish(unsigned char digest[DIGEST_SIZE]) {
+        uint64_t bits = totalLength * 8;
+        block[blockLength++] = 0x80;
+        if (blockLength > 56) {
+            std::memset(block + blockLength, 0, sizeof(block) - blockLength);
+            compress(block);
+            blockLength = 0;
+        }
+        std::memset(block + blockLength, 0, 56 - blockLength);
+        for (int i = 0; i < 8; ++i) block[56 + i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+        compress(block);
+        for (int i = 0; i < 8; ++i) {
+            for (int j = 0; j < 4; ++j) digest[4 * i + j] = static_cast<unsigned char>(state[i] >> (24 - 8 * j));
         }
     }
 };
 
+// PBKDF2-HMAC-SHA256 producing one 32-byte block
+inline void pbkdf2Sha256(std::string_view password, std::string_view salt, uint32_t iterations,
+                         unsigned char out[Sha256::DIGEST_SIZE]) {
+    // HMAC key pads, computed once and reused for every iteration
+    unsigned char key[64] = {};
+    if (password.size() > sizeof(key)) {
+        Sha256 keyHash;
+        keyHash.update(password.data(), password.size());
+        keyHash.finish(key);
+    } else {
+        std::memcpy(key, password.data(), password.size());
+    }
+    unsigned char innerPad[64], outerPad[64];
+    for (size_t i = 0; i < sizeof(key); ++i) {
+        innerPad[i] = key[i] ^ 0x36;
+        outerPad[i] = key[i] ^ 0x5c;
+    }
+    // Hash states after the pad blocks, copied instead of recomputed per iteration
+    Sha256 innerBase, outerBase;
+    innerBase.update(innerPad, sizeof(innerPad));
+    outerBase.update(outerPad, sizeof(outerPad));
+    auto hmac = [&](const void* message, size_t length, unsigned char* digest) {
+        Sha256 inner = innerBase;
+        inner.update(message, length);
+        inner.finish(digest);
+        Sha256 outer = outerBase;
+        outer.update(digest, Sha256::DIGEST_SIZE);
+        outer.finish(digest);
+    };
+
+    std::string first(salt);
+    first += std::string("\0\0\0\1", 4);  // block index 1, big-endian
+    unsigned char u[Sha256::DIGEST_SIZE];
+    hmac(first.data(), first.size(), u);
+    std::memcpy(out, u, sizeof(u));
+    for (uint32_t i = 1; i < iterations; ++i) {
+        hmac(u, sizeof(u), u);
+        for (size_t j = 0; j < sizeof(u); ++j) out[j] ^= u[j];
+    }
+}
+
+// Compare without an early exit, so timing does not reveal the mismatch position
+inline bool constantTimeEquals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    unsigned char diff = 0;
+    for (size_t i = 0; i < a.size(); ++i) diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+    return diff == 0;
+}
+
+inline std::string toHex(const unsigned char* bytes, size_t length) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(length * 2, '0');
+    for (size_t i = 0; i < length; ++i) {
+        hex[2 * i] = digits[bytes[i] >> 4];
+        hex[2 * i + 1] = digits[bytes[i] & 15];
+    }
+    return hex;
+}
+
+// Stored passwords are "pbkdf2$<iterations>$<salt hex>$<hash hex>"; the format
+// contains no commas so it fits the comma-separated users.txt rows. Rows that
+// carry a hash end with an extra PASSWORD_HASHED_MARKER field, so a plaintext
+// password from an older file is never mistaken for a hash by its prefix.
+const uint32_t PASSWORD_HASH_ITERATIONS = 10000;
+const char* const PASSWORD_HASH_PREFIX = "pbkdf2$";
+const char* const PASSWORD_HASHED_MARKER = "hashed";
+
+inline bool isPasswordHash(std::string_view stored) {
+    return stored.substr(0, std::strlen(PASSWORD_HASH_PREFIX)) == PASSWORD_HASH_PREFIX;
+}
+
+inline std::string hashPassword(std::string_view password, std::string_view saltHex,
+                                uint32_t iterations = PASSWORD_HASH_ITERATIONS) {
+    unsigned char derived[Sha256::DIGEST_SIZE];
+    pbkdf2Sha256(password, saltHex, iterations, derived);
+    return PASSWORD_HASH_PREFIX + std::to_string(iterations) + "$" + std::string(saltHex) + "$" +
+           toHex(derived, sizeof(derived));
+}
+
+// Hash with a fresh random 128-bit salt
+inline std::string hashPassword(std::string_view password) {
+    static std::mutex saltMutex;
+    static std::random_device entropy;
+    unsigned char salt[16];
+    {
+        std::lock_guard<std::mutex> lock(saltMutex);
+        for (size_t i = 0; i < sizeof(salt); i += 4) {
+            uint32_t word = entropy();
+            std::memcpy(salt + i, &word, 4);
+        }
+    }
+    return hashPassword(password, toHex(salt, sizeof(salt)));
+}
+
+// Re-derive with the stored salt and iteration count, then compare in constant time
+inline bool verifyPassword(std::string_view password, std::string_view stored) {
+    if (!isPasswordHash(stored)) return false;
+    std::string_view fields[4];
+    int iterations = 0;
+    if (splitFields(stored, '$', fields, 4) != 4 || !parseInt(fields[1], iterations) || iterations <= 0) {
+        return false;
+    }
+    return constantTimeEquals(hashPassword(password, fields[2], static_cast<uint32_t>(iterations)), stored);
+}
+
 // User class
 class User {
 protected:
@@ -105,6 +878,46 @@ protected:
     std::string email;
     std::vector<int> issuedBooks;
 
+    // Parse the id/name/email/issued-books fields shared by every user type
+    bool parseCommonFields(const std::string_view* tokens) {
+        int id;
+        if (!parseInt(tokens[0], id)) return false;
+
+        // Parse issued books
+        std::vector<int> parsed;
+        std::string_view booksStr = tokens[4];
+        while (!booksStr.empty()) {
+            size_t bookPos = booksStr.find(';');
+            int bookId;
+            if (!parseInt(booksStr.substr(0, bookPos), bookId)) return false;
+            parsed.push_back(bookId);
+            if (bookPos == std::string_view::npos) break;
+            booksStr.remove_prefix(bookPos + 1);
+        }
+
+        userId = id;
+        name.assign(tokens[1]);
+        email.assign(tokens[2]);
+        issuedBooks.swap(parsed);
+        return true;
+    }
+
+    // Append the id/name/email/type/issued-books fields shared by every user type
+    void appendCommonFields(std::string& out, const char* type) const {
+        appendInt(out, userId);
+        out += ',';
+        out += name;
+        out += ',';
+        out += email;
+        out += ',';
+        out += type;
+        out += ',';
+        for (size_t i = 0; i < issuedBooks.size(); ++i) {
+            if (i > 0) out += ';';
+            appendInt(out, issuedBooks[i]);
+        }
+    }
+
 public:
     // Default constructor
     User() : userId(0), name(""), email("") {}
@@ -121,6 +934,7 @@ public:
     std::string getName() const { return name; }
     std::string getEmail() const { return email; }
     const std::vector<int>& getIssuedBooks() const { return issuedBooks; }
+    void setIssuedBooks(std::vector<int> bookIds) { issuedBooks.swap(bookIds); }
 
     // Setters
     void setUserId(int id) { userId = id; }
@@ -147,48 +961,23 @@ public:
     }
 
     // Function to save user data to file
-    virtual std::string toFileString() const {
-        std::string booksStr = "";
-        for (size_t i = 0; i < issuedBooks.size(); ++i) {
-            booksStr += std::to_string(issuedBooks[i]);
-            if (i < issuedBooks.size() - 1) booksStr += ";";
-        }
-        return std::to_string(userId) + "," + name + "," + email + ",USER," + booksStr;
+    std::string toFileString() const {
+        std::string row;
+        appendFileString(row);
+        return row;
     }
 
-    // Function to load user data from file string
-    virtual void fromFileString(const std::string& data) {
-        size_t pos = 0;
-        std::string token;
-        std::vector<std::string> tokens;
-        std::string temp = data;
-        
-        while ((pos = temp.find(',')) != std::string::npos) {
-            token = temp.substr(0, pos);
-            tokens.push_back(token);
-            temp.erase(0, pos + 1);
-        }
-        tokens.push_back(temp);
+    // Append the users.txt row (without newline) to a reused buffer
+    virtual void appendFileString(std::string& out) const {
+        appendCommonFields(out, "USER");
+    }
 
-        if (tokens.size() >= 5) {
-            userId = std::stoi(tokens[0]);
-            name = tokens[1];
-            email = tokens[2];
-            // tokens[3] is user type
-            
-            // Parse issued books
-            if (!tokens[4].empty()) {
-                std::string booksStr = tokens[4];
-                size_t bookPos = 0;
-                while ((bookPos = booksStr.find(';')) != std::string::npos) {
-                    issuedBooks.push_back(std::stoi(booksStr.substr(0, bookPos)));
-                    booksStr.erase(0, bookPos + 1);
-                }
-                if (!booksStr.empty()) {
-                    issuedBooks.push_back(std::stoi(booksStr));
-                }
-            }
-        }
+    // Function to load user data from file string; returns false if malformed
+    virtual bool fromFileString(std::string_view data) {
+        std::string_view tokens[5];
+        if (splitFields(data, ',', tokens, 5) < 5) return false;
+        // tokens[3] is user type
+        return parseCommonFields(tokens);
     }
 };
 
@@ -196,23 +985,41 @@ public:
 class Admin : public User {
 private:
     std::string username;
-    std::string password;
+    std::string passwordHash;
 
 public:
     // Default constructor
-    Admin() : User(), username(""), password("") {}
+    Admin() : User(), username(""), passwordHash("") {}
     
-    // Parameterized constructor
+    // Parameterized constructor; the password is stored only as a salted hash
     Admin(int id, const std::string& n, const std::string& e, const std::string& u, const std::string& p) 
-        : User(id, n, e), username(u), password(p) {}
+        : User(id, n, e), username(u), passwordHash(hashPassword(p)) {}
+
+    // Build from a stored hash (see setStoredPassword)
+    static Admin fromStored(int id, const std::string& n, const std::string& e, const std::string& u,
+                            std::string_view stored) {
+        Admin admin;
+        admin.setUserId(id);
+        admin.setName(n);
+        admin.setEmail(e);
+        admin.setUsername(u);
+        admin.setStoredPassword(stored, true);
+        return admin;
+    }
 
     // Getters
     std::string getUsername() const { return username; }
-    std::string getPassword() const { return password; }
+    const std::string& getPasswordHash() const { return passwordHash; }
 
     // Setters
     void setUsername(const std::string& u) { username = u; }
-    void setPassword(const std::string& p) { password = p; }
+    void setPassword(const std::string& p) { passwordHash = hashPassword(p); }
+
+    // Accept a stored hash as is (a malformed one just never verifies); plaintext
+    // from older data files is hashed on load
+    void setStoredPassword(std::string_view stored, bool hashed) {
+        passwordHash = hashed ? std::string(stored) : hashPassword(stored);
+    }
 
     // Override display function (polymorphism)
     void display() const override {
@@ -224,518 +1031,5592 @@ public:
     }
 
     // Override file operations
-    std::string toFileString() const override {
-        std::string booksStr = "";
-        for (size_t i = 0; i < issuedBooks.size(); ++i) {
-            booksStr += std::to_string(issuedBooks[i]);
-            if (i < issuedBooks.size() - 1) booksStr += ";";
-        }
-        return std::to_string(userId) + "," + name + "," + email + ",ADMIN," + booksStr + "," + username + "," + password;
+    void appendFileString(std::string& out) const override {
+        appendCommonFields(out, "ADMIN");
+        out += ',';
+        out += username;
+        out += ',';
+        out += passwordHash;
+        out += ',';
+        out += PASSWORD_HASHED_MARKER;
     }
 
-    void fromFileString(const std::string& data) override {
-        size_t pos = 0;
-        std::string token;
-        std::vector<std::string> tokens;
-        std::string temp = data;
-        
-        while ((pos = temp.find(',')) != std::string::npos) {
-            token = temp.substr(0, pos);
-            tokens.push_back(token);
-            temp.erase(0, pos + 1);
-        }
-        tokens.push_back(temp);
+    bool fromFileString(std::string_view data) override {
+        std::string_view tokens[8];
+        size_t count = splitFields(data, ',', tokens, 8);
+        if (count < 7) return false;
+        // tokens[3] is user type
+        if (!parseCommonFields(tokens)) return false;
 
-        if (tokens.size() >= 7) {
-            userId = std::stoi(tokens[0]);
-            name = tokens[1];
-            email = tokens[2];
-            // tokens[3] is user type
-            
-            // Parse issued books
-            if (!tokens[4].empty()) {
-                std::string booksStr = tokens[4];
-                size_t bookPos = 0;
-                while ((bookPos = booksStr.find(';')) != std::string::npos) {
-                    issuedBooks.push_back(std::stoi(booksStr.substr(0, bookPos)));
-                    booksStr.erase(0, bookPos + 1);
-                }
-                if (!booksStr.empty()) {
-                    issuedBooks.push_back(std::stoi(booksStr));
-                }
-            }
-            
-            username = tokens[5];
-            password = tokens[6];
-        }
+        // Older rows end at the plaintext password
+        username.assign(tokens[5]);
+        setStoredPassword(tokens[6], count == 8 && tokens[7] == PASSWORD_HASHED_MARKER);
+        return true;
     }
 
     // Function to authenticate admin
     bool authenticate(const std::string& u, const std::string& p) const {
-        return (username == u && password == p);
+        return username == u && verifyPassword(p, passwordHash);
     }
 };
 
-// Library Management System class
-class LibrarySystem {
+// Slab allocator for User and Admin objects: equal-sized slots carved from
+// chunks of 1024 and recycled through a free list, so a large user table is a
+// few big allocations instead of one per user. Objects are built in place by
+// create() and released with destroy(); the pool itself only frees chunks.
+// Not thread-safe: LibrarySystem uses it under the exclusive catalog lock.
+class UserPool {
 private:
-    std::vector<Book> books;
-    std::vector<User*> users;
-    std::unordered_map<int, int> bookIdToIndex;
-    std::map<int, int> userIdToIndex;
-    int nextBookId;
-    int nextUserId;
-    Admin* currentAdmin;
+    static constexpr size_t SLOT_SIZE = sizeof(Admin) > sizeof(User) ? sizeof(Admin) : sizeof(User);
+    static constexpr size_t SLOTS_PER_CHUNK = 1024;
 
-    // File names
-    const std::string BOOKS_FILE = "books.txt";
-    const std::string USERS_FILE = "users.txt";
+    struct alignas(alignof(Admin) > alignof(User) ? alignof(Admin) : alignof(User)) Slot {
+        unsigned char bytes[SLOT_SIZE];
+    };
 
-public:
-    // Constructor
-    LibrarySystem() : nextBookId(1), nextUserId(1), currentAdmin(nullptr) {
-        // Create default admin
-        Admin* defaultAdmin = new Admin(0, "System Admin", "admin@library.com", "admin", "admin123");
-        users.push_back(defaultAdmin);
-        userIdToIndex[0] = 0;
-        
-        loadData();
-    }
+    struct FreeSlot {
+        FreeSlot* next;
+    };
 
-    // Destructor
-    ~LibrarySystem() {
-        saveData();
-        for (User* user : users) {
-            delete user;
+    std::vector<std::unique_ptr<Slot[]>> chunks;
+    size_t chunkUsed = SLOTS_PER_CHUNK;  // slots handed out from chunks.back()
+    FreeSlot* freeList = nullptr;
+    size_t liveCount = 0;
+
+    void* allocate() {
+        if (freeList) {
+            FreeSlot* slot = freeList;
+            freeList = slot->next;
+            return slot;
         }
+        if (chunkUsed == SLOTS_PER_CHUNK) {
+            chunks.emplace_back(new Slot[SLOTS_PER_CHUNK]);
+            chunkUsed = 0;
+        }
+        return &chunks.back()[chunkUsed++];
     }
 
-    // Function overloading for adding books
-    void addBook(const std::string& title, const std::string& author, const std::string& isbn) {
-        addBook(nextBookId++, title, author, isbn);
-    }
+    void release(void* memory) { freeList = new (memory) FreeSlot{freeList}; }
 
-    void addBook(int id, const std::string& title, const std::string& author, const std::string& isbn) {
+public:
+    UserPool() {}
+    UserPool(const UserPool&) = delete;
+    UserPool& operator=(const UserPool&) = delete;
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        static_assert(sizeof(T) <= sizeof(Slot) && alignof(T) <= alignof(Slot), "user type does not fit a slot");
+        void* memory = allocate();
         try {
-            Book newBook(id, title, author, isbn);
-            books.push_back(newBook);
-            bookIdToIndex[id] = books.size() - 1;
-            if (id >= nextBookId) nextBookId = id + 1;
-            std::cout << "Book added successfully!" << std::endl;
-        } catch (const std::exception& e) {
-            std::cout << "Error adding book: " << e.what() << std::endl;
+            T* object = new (memory) T(std::forward<Args>(args)...);
+            ++liveCount;
+            return object;
+        } catch (...) {
+            release(memory);
+            throw;
         }
     }
 
-    // View all books
-    void viewBooks() const {
-        if (books.empty()) {
-            std::cout << "No books available in the library." << std::endl;
-            return;
+    void destroy(User* user) {
+        if (!user) return;
+        user->~User();
+        release(user);
+        --liveCount;
+    }
+
+    // Take over another pool's chunks, and with them the objects it created;
+    // slots it never handed out become free slots here
+    void absorb(UserPool& other) {
+        if (other.chunks.empty()) return;
+        for (size_t i = other.chunkUsed; i < SLOTS_PER_CHUNK; ++i) release(&other.chunks.back()[i]);
+        while (other.freeList) {
+            FreeSlot* slot = other.freeList;
+            other.freeList = slot->next;
+            release(slot);
         }
+        // Keep this pool's partly used chunk last so allocation carries on from it
+        auto position = chunks.empty() ? chunks.end() : chunks.end() - 1;
+        chunks.insert(position, std::make_move_iterator(other.chunks.begin()),
+                      std::make_move_iterator(other.chunks.end()));
+        liveCount += other.liveCount;
+        other.chunks.clear();
+        other.chunkUsed = SLOTS_PER_CHUNK;
+        other.liveCount = 0;
+    }
 
-        std::cout << "\n" << std::string(90, '=') << std::endl;
-        std::cout << "LIBRARY BOOKS" << std::endl;
-        std::cout << std::string(90, '=') << std::endl;
-        std::cout << std::left << std::setw(5) << "ID" 
-                  << std::setw(25) << "Title" 
-                  << std::setw(20) << "Author" 
-                  << std::setw(15) << "ISBN" 
-                  << std::setw(10) << "Status"
-                  << std::setw(10) << "User ID" << std::endl;
-        std::cout << std::string(90, '-') << std::endl;
+    size_t size() const { return liveCount; }
+    size_t memoryUsage() const { return chunks.size() * SLOTS_PER_CHUNK * sizeof(Slot); }
+};
 
-        for (const auto& book : books) {
-            book.display(); // Polymorphism in action
-        }
-        std::cout << std::string(90, '=') << std::endl;
+// Parse one users.txt row into a User or Admin from the pool; nullptr if malformed
+inline User* parseUserRow(std::string_view line, UserPool& pool) {
+    // Determine user type from the fourth field
+    std::string_view tokens[4];
+    bool isAdmin = splitFields(line, ',', tokens, 4) >= 4 && tokens[3] == "ADMIN";
+
+    User* user = isAdmin ? static_cast<User*>(pool.create<Admin>()) : pool.create<User>();
+    if (!user->fromFileString(line)) {
+        pool.destroy(user);
+        return nullptr;
     }
+    return user;
+}
 
-    // Search books (function overloading)
-    void searchBooks(const std::string& query, const std::string& searchType) {
-        std::vector<Book> results;
-        
-        for (const auto& book : books) {
-            if (searchType == "title" && book.getTitle().find(query) != std::string::npos) {
-                results.push_back(book);
-            } else if (searchType == "author" && book.getAuthor().find(query) != std::string::npos) {
-                results.push_back(book);
-            } else if (searchType == "isbn" && book.getIsbn().find(query) != std::string::npos) {
-                results.push_back(book);
-            }
-        }
+// Versioned binary snapshot of the book and user tables.
+//
+// Layout (native little-endian, every section 8-byte aligned):
+//   Header | BookRecord[bookCount] | UserRecord[userCount] | int32 issued[issuedCount] | char heap[heapSize]
+// Strings live once in a deduplicated heap and are referenced by offset/length;
+// each user's issued books are a range of the shared issued array. The checksum
+// covers everything after the header, so a torn or truncated file is rejected.
+class BinarySnapshot {
+public:
+    static const uint32_t VERSION = 1;
 
-        if (results.empty()) {
-            std::cout << "No books found matching your search criteria." << std::endl;
-            return;
-        }
-
-        std::cout << "\nSearch Results:" << std::endl;
-        std::cout << std::string(90, '-') << std::endl;
-        std::cout << std::left << std::setw(5) << "ID" 
-                  << std::setw(25) << "Title" 
-                  << std::setw(20) << "Author" 
-                  << std::setw(15) << "ISBN" 
-                  << std::setw(10) << "Status" << std::endl;
-        std::cout << std::string(90, '-') << std::endl;
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t bookCount;
+        uint64_t userCount;
+        uint64_t issuedCount;
+        uint64_t heapSize;
+        uint64_t bodySize;
+        uint64_t checksum;
+    };
 
-        for (const auto& book : results) {
-            book.display();
-        }
-    }
+    struct StringRef {
+        uint32_t offset;
+        uint32_t length;
+    };
 
-    // Update book
-    void updateBook(int bookId) {
-        try {
-            auto it = bookIdToIndex.find(bookId);
-            if (it == bookIdToIndex.end()) {
-                throw std::runtime_error("Book not found!");
-            }
+    struct BookRecord {
+        int32_t bookId;
+        int32_t issuedToUserId;
+        StringRef title;
+        StringRef author;
+        StringRef isbn;
+        uint32_t isIssued;
+        uint32_t reserved;
+    };
 
-            Book& book = books[it->second];
-            std::string input;
-            
-            std::cout << "Current Title: " << book.getTitle() << std::endl;
-            std::cout << "Enter new title (or press Enter to keep current): ";
-            std::cin.ignore();
-            std::getline(std::cin, input);
-            if (!input.empty()) book.setTitle(input);
+    struct UserRecord {
+        int32_t userId;
+        uint32_t isAdmin;
+        StringRef name;
+        StringRef email;
+        StringRef username;
+        StringRef password;
+        uint32_t issuedBegin;
+        uint32_t issuedCount;
+    };
 
-            std::cout << "Current Author: " << book.getAuthor() << std::endl;
-            std::cout << "Enter new author (or press Enter to keep current): ";
-            std::getline(std::cin, input);
-            if (!input.empty()) book.setAuthor(input);
+private:
+    static constexpr char MAGIC[8] = {'L', 'I', 'B', 'S', 'N', 'A', 'P', '\0'};
+    static const uint32_t BYTE_ORDER_MARK = 0x01020304;
 
-            std::cout << "Current ISBN: " << book.getIsbn() << std::endl;
-            std::cout << "Enter new ISBN (or press Enter to keep current): ";
-            std::getline(std::cin, input);
-            if (!input.empty()) book.setIsbn(input);
+    Header header;
+    const char* bookBase;
+    const char* userBase;
+    const char* issuedBase;
+    const char* heapBase;
 
-            std::cout << "Book updated successfully!" << std::endl;
+    static size_t align8(size_t n) { return (n + 7) & ~static_cast<size_t>(7); }
 
-        } catch (const std::exception& e) {
-            std::cout << "Error updating book: " << e.what() << std::endl;
+    // Word-at-a-time checksum; much faster than a bytewise hash on large snapshots
+    static uint64_t checksum64(std::string_view data) {
+        uint64_t hash = 0x9E3779B97F4A7C15ull ^ data.size();
+        size_t i = 0;
+        for (; i + 8 <= data.size(); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data.data() + i, 8);
+            hash = (hash ^ word) * 0x100000001B3ull;
+            hash ^= hash >> 29;
         }
+        for (; i < data.size(); ++i) {
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001B3ull;
+        }
+        return hash;
     }
 
-    // Delete book
-    void deleteBook(int bookId) {
-        try {
-            auto it = bookIdToIndex.find(bookId);
-            if (it == bookIdToIndex.end()) {
-                throw std::runtime_error("Book not found!");
-            }
+    // Deduplicating string heap used while encoding
+    class StringHeap {
+    private:
+        std::string bytes;
+        std::unordered_map<std::string, uint32_t> offsets;
 
-            int index = it->second;
-            if (books[index].getIsIssued()) {
-                throw std::runtime_error("Cannot delete an issued book!");
+    public:
+        StringRef add(std::string_view s) {
+            StringRef ref;
+            ref.length = static_cast<uint32_t>(s.size());
+            std::string key(s);
+            auto it = offsets.find(key);
+            if (it != offsets.end()) {
+                ref.offset = it->second;
+            } else {
+                ref.offset = static_cast<uint32_t>(bytes.size());
+                bytes += s;
+                offsets.emplace(std::move(key), ref.offset);
             }
+            return ref;
+        }
 
-            books.erase(books.begin() + index);
-            bookIdToIndex.erase(it);
+        const std::string& data() const { return bytes; }
+    };
 
-            // Update indices
-            bookIdToIndex.clear();
-            for (size_t i = 0; i < books.size(); ++i) {
-                bookIdToIndex[books[i].getBookId()] = i;
-            }
+    std::string_view str(const StringRef& ref) const {
+        return std::string_view(heapBase + ref.offset, ref.length);
+    }
 
-            std::cout << "Book deleted successfully!" << std::endl;
+    // Bytes taken by `count` records of `size` bytes, padded; false if that
+    // would exceed `limit` (checked by division, so it cannot overflow)
+    static bool sectionBytes(uint64_t count, size_t size, size_t limit, size_t& bytes) {
+        if (count > (limit - limit % 8) / size) return false;
+        bytes = align8(static_cast<size_t>(count) * size);
+        return true;
+    }
 
-        } catch (const std::exception& e) {
-            std::cout << "Error deleting book: " << e.what() << std::endl;
-        }
+    bool inHeap(const StringRef& ref) const {
+        return ref.offset <= header.heapSize && ref.length <= header.heapSize - ref.offset;
     }
 
-    // Issue book
-    void issueBook(int bookId, int userId) {
-        try {
-            auto bookIt = bookIdToIndex.find(bookId);
-            if (bookIt == bookIdToIndex.end()) {
-                throw std::runtime_error("Book not found!");
+    // Every string and issued range must lie inside its section, or reading
+    // the record would run off the image
+    bool recordsInBounds(std::string& error) const {
+        for (size_t i = 0; i < header.bookCount; ++i) {
+            BookRecord rec;
+            std::memcpy(&rec, bookBase + i * sizeof(BookRecord), sizeof(BookRecord));
+            if (!inHeap(rec.title) || !inHeap(rec.author) || !inHeap(rec.isbn)) {
+                error = "book record " + std::to_string(i) + " points outside the string heap";
+                return false;
             }
-
-            auto userIt = userIdToIndex.find(userId);
-            if (userIt == userIdToIndex.end()) {
-                throw std::runtime_error("User not found!");
+        }
+        for (size_t i = 0; i < header.userCount; ++i) {
+            UserRecord rec;
+            std::memcpy(&rec, userBase + i * sizeof(UserRecord), sizeof(UserRecord));
+            if (!inHeap(rec.name) || !inHeap(rec.email) || !inHeap(rec.username) || !inHeap(rec.password)) {
+                error = "user record " + std::to_string(i) + " points outside the string heap";
+                return false;
             }
-
-            Book& book = books[bookIt->second];
-            if (book.getIsIssued()) {
-                throw std::runtime_error("Book is already issued!");
+            if (rec.issuedBegin > header.issuedCount || rec.issuedCount > header.issuedCount - rec.issuedBegin) {
+                error = "user record " + std::to_string(i) + " points outside the issued array";
+                return false;
             }
+        }
+        return true;
+    }
 
-            User* user = users[userIt->second];
-            book.setIsIssued(true);
-            book.setIssuedToUserId(userId);
-            user->addIssuedBook(bookId);
+public:
+    BinarySnapshot() : header(), bookBase(nullptr), userBase(nullptr), issuedBase(nullptr), heapBase(nullptr) {}
 
-            std::cout << "Book issued successfully to " << user->getName() << std::endl;
+    // Encode a book range and user list into a snapshot image
+    template <typename BookRange>
+    static std::string encode(const BookRange& books, const std::vector<User*>& users) {
+        StringHeap heap;
+        std::vector<BookRecord> bookRecords;
+        std::vector<UserRecord> userRecords;
+        std::vector<int32_t> issued;
 
-        } catch (const std::exception& e) {
-            std::cout << "Error issuing book: " << e.what() << std::endl;
+        for (const auto& book : books) {
+            BookRecord rec = {};
+            rec.bookId = book.getBookId();
+            rec.issuedToUserId = book.getIssuedToUserId();
+            rec.title = heap.add(book.getTitle());
+            rec.author = heap.add(book.getAuthor());
+            rec.isbn = heap.add(book.getIsbn());
+            rec.isIssued = book.getIsIssued() ? 1 : 0;
+            bookRecords.push_back(rec);
+        }
+
+        userRecords.reserve(users.size());
+        for (const User* user : users) {
+            UserRecord rec = {};
+            rec.userId = user->getUserId();
+            rec.name = heap.add(user->getName());
+            rec.email = heap.add(user->getEmail());
+            const Admin* admin = dynamic_cast<const Admin*>(user);
+            rec.isAdmin = admin ? 1 : 0;
+            rec.username = heap.add(admin ? admin->getUsername() : std::string());
+            rec.password = heap.add(admin ? admin->getPasswordHash() : std::string());
+            rec.issuedBegin = static_cast<uint32_t>(issued.size());
+            rec.issuedCount = static_cast<uint32_t>(user->getIssuedBooks().size());
+            issued.insert(issued.end(), user->getIssuedBooks().begin(), user->getIssuedBooks().end());
+            userRecords.push_back(rec);
         }
+
+        Header h = {};
+        std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+        h.version = VERSION;
+        h.byteOrder = BYTE_ORDER_MARK;
+        h.bookCount = bookRecords.size();
+        h.userCount = userRecords.size();
+        h.issuedCount = issued.size();
+        h.heapSize = heap.data().size();
+
+        size_t booksBytes = align8(bookRecords.size() * sizeof(BookRecord));
+        size_t usersBytes = align8(userRecords.size() * sizeof(UserRecord));
+        size_t issuedBytes = align8(issued.size() * sizeof(int32_t));
+        h.bodySize = booksBytes + usersBytes + issuedBytes + align8(h.heapSize);
+
+        std::string out(sizeof(Header) + h.bodySize, '\0');
+        char* body = &out[sizeof(Header)];
+        if (!bookRecords.empty()) std::memcpy(body, bookRecords.data(), bookRecords.size() * sizeof(BookRecord));
+        if (!userRecords.empty()) std::memcpy(body + booksBytes, userRecords.data(), userRecords.size() * sizeof(UserRecord));
+        if (!issued.empty()) std::memcpy(body + booksBytes + usersBytes, issued.data(), issued.size() * sizeof(int32_t));
+        if (h.heapSize) std::memcpy(body + booksBytes + usersBytes + issuedBytes, heap.data().data(), h.heapSize);
+
+        h.checksum = checksum64(std::string_view(body, h.bodySize));
+        std::memcpy(&out[0], &h, sizeof(Header));
+        return out;
     }
 
-    // Return book
-    void returnBook(int bookId) {
-        try {
-            auto bookIt = bookIdToIndex.find(bookId);
-            if (bookIt == bookIdToIndex.end()) {
-                throw std::runtime_error("Book not found!");
-            }
+    // Validate a snapshot image and bind to it; the image must outlive this object
+    bool open(std::string_view image, std::string& error) {
+        if (image.size() < sizeof(Header)) {
+            error = "file too short for header";
+            return false;
+        }
+        std::memcpy(&header, image.data(), sizeof(Header));
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+            error = "not a library snapshot";
+            return false;
+        }
+        if (header.version != VERSION) {
+            error = "unsupported snapshot version " + std::to_string(header.version);
+            return false;
+        }
+        if (header.byteOrder != BYTE_ORDER_MARK) {
+            error = "snapshot was written on a machine with a different byte order";
+            return false;
+        }
 
-            Book& book = books[bookIt->second];
-            if (!book.getIsIssued()) {
-                throw std::runtime_error("Book is not currently issued!");
-            }
+        // No section can be larger than the body, so the sum below cannot overflow
+        size_t bodyBytes = image.size() - sizeof(Header);
+        size_t booksBytes, usersBytes, issuedBytes, heapBytes;
+        if (!sectionBytes(header.bookCount, sizeof(BookRecord), bodyBytes, booksBytes) ||
+            !sectionBytes(header.userCount, sizeof(UserRecord), bodyBytes, usersBytes) ||
+            !sectionBytes(header.issuedCount, sizeof(int32_t), bodyBytes, issuedBytes) ||
+            !sectionBytes(header.heapSize, 1, bodyBytes, heapBytes) || header.bodySize != bodyBytes ||
+            bodyBytes != booksBytes + usersBytes + issuedBytes + heapBytes) {
+            error = "file is truncated or has trailing data";
+            return false;
+        }
 
-            int userId = book.getIssuedToUserId();
-            auto userIt = userIdToIndex.find(userId);
-            if (userIt != userIdToIndex.end()) {
-                users[userIt->second]->removeIssuedBook(bookId);
-            }
+        std::string_view body = image.substr(sizeof(Header));
+        if (checksum64(body) != header.checksum) {
+            error = "checksum mismatch";
+            return false;
+        }
 
-            book.setIsIssued(false);
-            book.setIssuedToUserId(-1);
+        bookBase = body.data();
+        userBase = bookBase + booksBytes;
+        issuedBase = userBase + usersBytes;
+        heapBase = issuedBase + issuedBytes;
+        return recordsInBounds(error);
+    }
 
-            std::cout << "Book returned successfully!" << std::endl;
+    size_t bookCount() const { return header.bookCount; }
+    size_t userCount() const { return header.userCount; }
 
-        } catch (const std::exception& e) {
-            std::cout << "Error returning book: " << e.what() << std::endl;
+    Book book(size_t i) const {
+        BookRecord rec;
+        std::memcpy(&rec, bookBase + i * sizeof(BookRecord), sizeof(BookRecord));
+        return Book(rec.bookId, str(rec.title), str(rec.author), str(rec.isbn), rec.isIssued != 0,
+                    rec.issuedToUserId);
+    }
+
+    // The returned User/Admin comes from the pool; the caller destroys it there
+    User* user(size_t i, UserPool& pool) const {
+        UserRecord rec;
+        std::memcpy(&rec, userBase + i * sizeof(UserRecord), sizeof(UserRecord));
+        User* user;
+        if (rec.isAdmin) {
+            user = pool.create<Admin>(Admin::fromStored(rec.userId, std::string(str(rec.name)),
+                                                        std::string(str(rec.email)), std::string(str(rec.username)),
+                                                        str(rec.password)));
+        } else {
+            user = pool.create<User>(rec.userId, std::string(str(rec.name)), std::string(str(rec.email)));
         }
+        std::vector<int> issued(rec.issuedCount);
+        if (rec.issuedCount) {
+            std::memcpy(issued.data(), issuedBase + rec.issuedBegin * sizeof(int32_t), rec.issuedCount * sizeof(int32_t));
+        }
+        user->setIssuedBooks(std::move(issued));
+        return user;
     }
+};
 
-    // Add user
-    void addUser(const std::string& name, const std::string& email, bool isAdmin = false, 
-                 const std::string& username = "", const std::string& password = "") {
-        try {
-            User* newUser;
-            if (isAdmin) {
-                newUser = new Admin(nextUserId, name, email, username, password);
+// Convert books.txt/users.txt into a binary snapshot
+inline bool convertTextToBinary(const std::string& booksPath, const std::string& usersPath,
+                                const std::string& snapshotPath) {
+    std::vector<Book> books;
+    std::vector<User*> users;
+    UserPool pool;
+    MappedFile file;
+    if (file.open(booksPath)) {
+        forEachLine(file.view(), [&](size_t lineNumber, std::string_view line) {
+            Book book;
+            if (book.fromFileString(line)) {
+                books.push_back(std::move(book));
+            } else {
+                std::cout << "Skipping malformed line " << lineNumber << " in " << booksPath << std::endl;
+            }
+        });
+    }
+    if (file.open(usersPath)) {
+        forEachLine(file.view(), [&](size_t lineNumber, std::string_view line) {
+            User* user = parseUserRow(line, pool);
+            if (user) {
+                users.push_back(user);
             } else {
-                newUser = new User(nextUserId, name, email);
+                std::cout << "Skipping malformed line " << lineNumber << " in " << usersPath << std::endl;
             }
-            
-            users.push_back(newUser);
-            userIdToIndex[nextUserId] = users.size() - 1;
-            nextUserId++;
+        });
+    }
+    bool ok = writeFileAtomically(snapshotPath, BinarySnapshot::encode(books, users));
+    std::cout << (ok ? "Wrote " : "Failed to write ") << books.size() << " books and " << users.size()
+              << " users to " << snapshotPath << std::endl;
+    for (User* user : users) pool.destroy(user);
+    return ok;
+}
 
-            std::cout << (isAdmin ? "Admin" : "User") << " added successfully!" << std::endl;
+// Convert a binary snapshot back into books.txt/users.txt
+inline bool convertBinaryToText(const std::string& snapshotPath, const std::string& booksPath,
+                                const std::string& usersPath) {
+    MappedFile file;
+    if (!file.open(snapshotPath)) {
+        std::cout << "Cannot open " << snapshotPath << std::endl;
+        return false;
+    }
+    BinarySnapshot snapshot;
+    std::string error;
+    if (!snapshot.open(file.view(), error)) {
+        std::cout << "Invalid snapshot " << snapshotPath << ": " << error << std::endl;
+        return false;
+    }
 
-        } catch (const std::exception& e) {
-            std::cout << "Error adding user: " << e.what() << std::endl;
-        }
+    std::string booksData, usersData;
+    UserPool pool;
+    for (size_t i = 0; i < snapshot.bookCount(); ++i) {
+        booksData += snapshot.book(i).toFileString();
+        booksData += '\n';
+    }
+    for (size_t i = 0; i < snapshot.userCount(); ++i) {
+        User* user = snapshot.user(i, pool);
+        usersData += user->toFileString();
+        usersData += '\n';
+        pool.destroy(user);
     }
+    bool ok = writeFileAtomically(booksPath, booksData) && writeFileAtomically(usersPath, usersData);
+    std::cout << (ok ? "Wrote " : "Failed to write ") << snapshot.bookCount() << " books and "
+              << snapshot.userCount() << " users from " << snapshotPath << std::endl;
+    return ok;
+}
 
-    // View all users
-    void viewUsers() const {
-        if (users.empty()) {
-            std::cout << "No users registered in the system." << std::endl;
-            return;
+// Columnar slot-map storage for books: slots stay put across deletes, freed
+// slots are reused. Text columns are pool handles whose characters sit
+// contiguously in the StringPool arena.
+class BookStore {
+private:
+    // One array per field, indexed by slot. Scans read only the columns they
+    // need: a status count touches two bytes per book, a title scan one handle.
+    std::vector<int> ids;
+    std::vector<InternedString> titles;
+    std::vector<InternedString> authors;
+    std::vector<InternedString> isbns;
+    std::vector<uint8_t> issued;
+    std::vector<int> issuedTo;
+    std::vector<char> live;
+    std::vector<size_t> freeSlots;
+    size_t liveCount;
+
+    void writeRow(size_t slot, const Book& book) {
+        ids[slot] = book.getBookId();
+        titles[slot] = book.getTitleHandle();
+        authors[slot] = book.getAuthorHandle();
+        isbns[slot] = book.getIsbnHandle();
+        issued[slot] = book.getIsIssued() ? 1 : 0;
+        issuedTo[slot] = book.getIssuedToUserId();
+    }
+
+    void moveRow(size_t from, size_t to) {
+        ids[to] = ids[from];
+        titles[to] = titles[from];
+        authors[to] = authors[from];
+        isbns[to] = isbns[from];
+        issued[to] = issued[from];
+        issuedTo[to] = issuedTo[from];
+    }
+
+    void resizeColumns(size_t n) {
+        ids.resize(n);
+        titles.resize(n);
+        authors.resize(n);
+        isbns.resize(n);
+        issued.resize(n);
+        issuedTo.resize(n);
+        live.resize(n);
+    }
+
+public:
+    // Text columns
+    enum Field { TITLE, AUTHOR, ISBN };
+
+    // Compact once at least this fraction of slots are holes
+    static constexpr double COMPACT_THRESHOLD = 0.25;
+    // Never bother compacting tiny stores
+    static const size_t COMPACT_MIN_SLOTS = 64;
+
+    // Forward iterator over live slots; dereferencing assembles a Book row
+    class LiveIterator {
+    private:
+        const BookStore* store;
+        size_t slot;
+
+        void skipHoles() {
+            while (slot < store->live.size() && !store->live[slot]) ++slot;
         }
 
-        std::cout << "\n" << std::string(80, '=') << std::endl;
-        std::cout << "REGISTERED USERS" << std::endl;
-        std::cout << std::string(80, '=') << std::endl;
-        std::cout << std::left << std::setw(5) << "ID" 
-                  << std::setw(20) << "Name" 
-                  << std::setw(25) << "Email" 
-                  << std::setw(15) << "Type"
-                  << std::setw(10) << "Books" << std::endl;
-        std::cout << std::string(80, '-') << std::endl;
+    public:
+        LiveIterator(const BookStore* s, size_t pos) : store(s), slot(pos) { skipHoles(); }
+        Book operator*() const { return (*store)[slot]; }
+        LiveIterator& operator++() { ++slot; skipHoles(); return *this; }
+        bool operator!=(const LiveIterator& other) const { return slot != other.slot; }
+        bool operator==(const LiveIterator& other) const { return slot == other.slot; }
+        size_t index() const { return slot; }
+    };
 
-        for (const auto& user : users) {
-            user->display(); // Polymorphism in action
+    typedef LiveIterator iterator;
+    typedef LiveIterator const_iterator;
+
+    BookStore() : liveCount(0) {}
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, live.size()); }
+
+    // Assemble the row in a slot
+    Book operator[](size_t slot) const {
+        return Book(ids[slot], titles[slot], authors[slot], isbns[slot], issued[slot] != 0, issuedTo[slot]);
+    }
+
+    // Single-column accessors
+    int bookId(size_t slot) const { return ids[slot]; }
+    bool isIssued(size_t slot) const { return issued[slot] != 0; }
+    int issuedToUserId(size_t slot) const { return issuedTo[slot]; }
+
+    std::string_view text(Field field, size_t slot) const { return column(field)[slot].view(); }
+
+    const std::vector<InternedString>& column(Field field) const {
+        return field == TITLE ? titles : field == AUTHOR ? authors : isbns;
+    }
+
+    void set(size_t slot, const Book& book) { writeRow(slot, book); }
+
+    void setIssued(size_t slot, bool isIssuedNow, int userId) {
+        issued[slot] = isIssuedNow ? 1 : 0;
+        issuedTo[slot] = userId;
+    }
+
+    // Issued books among live slots; a pass over two byte arrays
+    size_t issuedCount() const {
+        size_t count = 0;
+        for (size_t slot = 0; slot < issued.size(); ++slot) {
+            count += static_cast<size_t>(issued[slot] & live[slot]);
         }
-        std::cout << std::string(80, '=') << std::endl;
+        return count;
     }
 
-    // Admin login
-    bool adminLogin(const std::string& username, const std::string& password) {
-        for (User* user : users) {
-            Admin* admin = dynamic_cast<Admin*>(user);
-            if (admin && admin->authenticate(username, password)) {
-                currentAdmin = admin;
-                return true;
-            }
+    bool empty() const { return liveCount == 0; }
+    size_t size() const { return liveCount; }
+    size_t slotCount() const { return live.size(); }
+    size_t holeCount() const { return live.size() - liveCount; }
+    bool isLive(size_t slot) const { return slot < live.size() && live[slot]; }
+
+    void reserve(size_t n) {
+        ids.reserve(n);
+        titles.reserve(n);
+        authors.reserve(n);
+        isbns.reserve(n);
+        issued.reserve(n);
+        issuedTo.reserve(n);
+        live.reserve(n);
+    }
+
+    // Store a book and return its slot, reusing a hole when one is free
+    size_t insert(const Book& book) {
+        size_t slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            slot = live.size();
+            resizeColumns(slot + 1);
         }
-        return false;
+        writeRow(slot, book);
+        live[slot] = 1;
+        ++liveCount;
+        return slot;
     }
 
-    // Admin logout
-    void adminLogout() {
-        currentAdmin = nullptr;
+    // Tombstone a slot in O(1)
+    void erase(size_t slot) {
+        if (!isLive(slot)) return;
+        writeRow(slot, Book());
+        live[slot] = 0;
+        freeSlots.push_back(slot);
+        --liveCount;
     }
 
-    // Check if admin is logged in
-    bool isAdminLoggedIn() const {
-        return currentAdmin != nullptr;
+    bool needsCompaction() const {
+        return live.size() >= COMPACT_MIN_SLOTS &&
+               static_cast<double>(holeCount()) >= COMPACT_THRESHOLD * live.size();
     }
 
-    // Get current admin
-    Admin* getCurrentAdmin() const {
-        return currentAdmin;
+    // Slide live rows down over the holes, keeping their relative order.
+    // Slot numbers change, so callers must rebuild any slot-keyed index afterwards.
+    void compact() {
+        size_t out = 0;
+        for (size_t in = 0; in < live.size(); ++in) {
+            if (!live[in]) continue;
+            if (out != in) moveRow(in, out);
+            live[out] = 1;
+            ++out;
+        }
+        resizeColumns(out);
+        freeSlots.clear();
     }
 
-    // Save data to files
-    void saveData() {
-        try {
-            // Save books
-            std::ofstream booksFile(BOOKS_FILE);
-            if (booksFile.is_open()) {
-                for (const auto& book : books) {
-                    booksFile << book.toFileString() << std::endl;
-                }
-                booksFile.close();
-            }
+    void clear() {
+        resizeColumns(0);
+        freeSlots.clear();
+        liveCount = 0;
+    }
+};
 
-            // Save users
-            std::ofstream usersFile(USERS_FILE);
-            if (usersFile.is_open()) {
-                for (const auto& user : users) {
-                    usersFile << user->toFileString() << std::endl;
-                }
-                usersFile.close();
-            }
+// Copy-on-write versions of the book table, so readers can scan one point in
+// time while writers keep committing. Slots mirror BookStore's, in 64-row
+// leaves under 256-leaf branches. A write copies only the leaf and branch it
+// touches and shares the rest with older versions; everything changed inside
+// a WriteScope becomes visible at once when the scope closes. Readers pin the
+// latest version without locking. A replaced node is freed by a later write
+// once no reader that might still see it remains (epoch-based reclamation).
+class CatalogVersions {
+public:
+    static const size_t LEAF_ROWS = 64;
+    static const size_t BRANCH_LEAVES = 256;
+    static const size_t BRANCH_ROWS = LEAF_ROWS * BRANCH_LEAVES;
+    // Snapshots held at once; further readers wait for one to be released
+    static const size_t MAX_READERS = 128;
+    // Replaced leaves let pile up before the reader pins are checked
+    static const size_t RECLAIM_BATCH = 32;
 
-        } catch (const std::exception& e) {
-            std::cout << "Error saving data: " << e.what() << std::endl;
+private:
+    // Same columns as BookStore, for 64 slots
+    struct Leaf {
+        uint64_t epoch;  // version that created it; changed in place only until that version is published
+        int ids[LEAF_ROWS];
+        InternedString titles[LEAF_ROWS];
+        InternedString authors[LEAF_ROWS];
+        InternedString isbns[LEAF_ROWS];
+        int issuedTo[LEAF_ROWS];
+        uint8_t issued[LEAF_ROWS];
+        uint8_t live[LEAF_ROWS];
+    };
+
+    struct Branch {
+        uint64_t epoch;
+        Leaf* leaves[BRANCH_LEAVES];  // nullptr until a slot in it is written
+    };
+
+    struct Version {
+        uint64_t epoch;  // versions are numbered 1, 2, ... in publishing order
+        size_t slotCount;
+        size_t liveCount;
+        size_t issuedCount;
+        std::vector<Branch*> branches;
+    };
+
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch{0};  // oldest version the reader may see, 0 when free
+    };
+
+    // A node unlinked by the version with this epoch; readers pinned at that
+    // epoch or later cannot reach it
+    template <typename T>
+    using RetiredList = std::vector<std::pair<uint64_t, T*>>;
+
+    std::atomic<Version*> published;
+    std::atomic<uint64_t> publishedEpoch;
+    mutable ReaderSlot readers[MAX_READERS];
+    std::recursive_mutex writeMutex;
+    size_t writeDepth;
+    Version* working;  // next version while a write has changed something, else nullptr
+    RetiredList<Leaf> retiredLeaves;
+    RetiredList<Branch> retiredBranches;
+    RetiredList<Version> retiredVersions;
+    // Freed nodes are kept for reuse: a write copies two nodes of about 2 KB,
+    // too large for the allocator's fast path
+    std::vector<Leaf*> freeLeaves;
+    std::vector<Branch*> freeBranches;
+    std::vector<Version*> freeVersions;
+    std::atomic<size_t> nodeBytes;
+
+    std::vector<Leaf*>& freeList(Leaf*) { return freeLeaves; }
+    std::vector<Branch*>& freeList(Branch*) { return freeBranches; }
+    std::vector<Version*>& freeList(Version*) { return freeVersions; }
+
+    template <typename T>
+    void release(T* node) { freeList(node).push_back(node); }
+
+    // A writable copy of a node (or an empty one), made by the working version
+    template <typename T>
+    T* copyNode(const T* node, uint64_t epoch) {
+        std::vector<T*>& pool = freeList(static_cast<T*>(nullptr));
+        T* copy;
+        if (pool.empty()) {
+            copy = node ? new T(*node) : new T();
+            nodeBytes.fetch_add(sizeof(T), std::memory_order_relaxed);
+        } else {
+            copy = pool.back();
+            pool.pop_back();
+            *copy = node ? *node : T();
         }
+        copy->epoch = epoch;
+        return copy;
     }
 
-    // Load data from files
-    void loadData() {
-        try {
-            // Load books
-            std::ifstream booksFile(BOOKS_FILE);
-            if (booksFile.is_open()) {
-                std::string line;
-                while (std::getline(booksFile, line)) {
-                    if (!line.empty()) {
-                        Book book;
-                        book.fromFileString(line);
-                        books.push_back(book);
-                        bookIdToIndex[book.getBookId()] = books.size() - 1;
-                        if (book.getBookId() >= nextBookId) {
-                            nextBookId = book.getBookId() + 1;
-                        }
-                    }
-                }
-                booksFile.close();
-            }
-
-            // Load users (skip default admin at index 0)
-            std::ifstream usersFile(USERS_FILE);
-            if (usersFile.is_open()) {
-                std::string line;
-                while (std::getline(usersFile, line)) {
-                    if (!line.empty()) {
-                        // Determine user type
-                        if (line.find(",ADMIN,") != std::string::npos) {
-                            Admin* admin = new Admin();
-                            admin->fromFileString(line);
-                            // Don't add if it's the default admin
-                            if (admin->getUserId() != 0) {
-                                users.push_back(admin);
-                                userIdToIndex[admin->getUserId()] = users.size() - 1;
-                                if (admin->getUserId() >= nextUserId) {
-                                    nextUserId = admin->getUserId() + 1;
-                                }
-                            } else {
-                                delete admin;
-                            }
-                        } else {
-                            User* user = new User();
-                            user->fromFileString(line);
-                            users.push_back(user);
-                            userIdToIndex[user->getUserId()] = users.size() - 1;
-                            if (user->getUserId() >= nextUserId) {
-                                nextUserId = user->getUserId() + 1;
-                            }
-                        }
-                    }
-                }
-                usersFile.close();
-            }
+    // Make a node of the working version writable: nodes it created already
+    // are, published ones are copied and retired
+    template <typename T>
+    T* writable(T* node, RetiredList<T>& retired) {
+        if (node && node->epoch == working->epoch) return node;
+        if (node) retired.emplace_back(working->epoch, node);
+        return copyNode(node, working->epoch);
+    }
 
-        } catch (const std::exception& e) {
-            std::cout << "Error loading data: " << e.what() << std::endl;
+    void openVersion() {
+        if (working) return;
+        const Version* current = published.load();
+        working = copyNode(current, current->epoch + 1);
+    }
+
+    // Leaf holding a slot in the working version, ready to change
+    Leaf* writableLeaf(size_t slot) {
+        openVersion();
+        size_t branchIndex = slot / BRANCH_ROWS;
+        if (branchIndex >= working->branches.size()) working->branches.resize(branchIndex + 1, nullptr);
+        Branch*& branch = working->branches[branchIndex];
+        branch = writable(branch, retiredBranches);
+        Leaf*& leaf = branch->leaves[(slot / LEAF_ROWS) % BRANCH_LEAVES];
+        leaf = writable(leaf, retiredLeaves);
+        return leaf;
+    }
+
+    void put(size_t slot, const Book& book) {
+        Leaf* leaf = writableLeaf(slot);
+        size_t row = slot % LEAF_ROWS;
+        if (leaf->live[row]) {
+            working->issuedCount -= leaf->issued[row];
+        } else {
+            ++working->liveCount;
         }
+        leaf->ids[row] = book.getBookId();
+        leaf->titles[row] = book.getTitleHandle();
+        leaf->authors[row] = book.getAuthorHandle();
+        leaf->isbns[row] = book.getIsbnHandle();
+        leaf->issued[row] = book.getIsIssued() ? 1 : 0;
+        leaf->issuedTo[row] = book.getIssuedToUserId();
+        leaf->live[row] = 1;
+        working->issuedCount += leaf->issued[row];
+        if (slot >= working->slotCount) working->slotCount = slot + 1;
     }
 
-    // Get input with validation
-    int getValidatedInput(int min, int max) {
-        int choice;
-        while (true) {
-            std::cout << "Enter your choice (" << min << "-" << max << "): ";
-            if (std::cin >> choice) {
-                if (choice >= min && choice <= max) {
-                    return choice;
+    void erase(size_t slot) {
+        Leaf* leaf = writableLeaf(slot);
+        size_t row = slot % LEAF_ROWS;
+        if (!leaf->live[row]) return;
+        --working->liveCount;
+        working->issuedCount -= leaf->issued[row];
+        leaf->live[row] = 0;
+        leaf->issued[row] = 0;
+    }
+
+    void setIssued(size_t slot, bool isIssued, int userId) {
+        Leaf* leaf = writableLeaf(slot);
+        size_t row = slot % LEAF_ROWS;
+        if (leaf->live[row]) working->issuedCount += (isIssued ? 1 : 0) - leaf->issued[row];
+        leaf->issued[row] = isIssued ? 1 : 0;
+        leaf->issuedTo[row] = userId;
+    }
+
+    // Rebuild the working version from the whole store, after a bulk load or
+    // a compaction renumbered the slots
+    void assign(const BookStore& store) {
+        openVersion();
+        for (Branch* branch : working->branches) {
+            if (!branch) continue;
+            for (Leaf* leaf : branch->leaves) {
+                if (!leaf) continue;
+                if (leaf->epoch == working->epoch) {
+                    release(leaf);
                 } else {
-                    std::cout << "Invalid choice! Please enter a number between " << min << " and " << max << "." << std::endl;
+                    retiredLeaves.emplace_back(working->epoch, leaf);
                 }
+            }
+            if (branch->epoch == working->epoch) {
+                release(branch);
             } else {
-                std::cout << "Invalid input! Please enter a valid number." << std::endl;
-                std::cin.clear();
-                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                retiredBranches.emplace_back(working->epoch, branch);
             }
         }
+        working->branches.clear();
+        working->slotCount = working->liveCount = working->issuedCount = 0;
+        for (auto it = store.begin(); it != store.end(); ++it) put(it.index(), *it);
+        working->slotCount = store.slotCount();
     }
 
-    // Main menu
-    void showMainMenu() {
-        std::cout << "\n" << std::string(50, '=') << std::endl;
-        std::cout << "    LIBRARY MANAGEMENT SYSTEM" << std::endl;
-        std::cout << std::string(50, '=') << std::endl;
-        std::cout << "1. Admin Login" << std::endl;
-        std::cout << "2. View Available Books" << std::endl;
-        std::cout << "3. Search Books" << std::endl;
-        std::cout << "4. Exit" << std::endl;
-        std::cout << std::string(50, '=') << std::endl;
+    void publish() {
+        if (!working) return;
+        Version* previous = published.load();
+        published.store(working);
+        publishedEpoch.store(working->epoch);
+        retiredVersions.emplace_back(working->epoch, previous);
+        working = nullptr;
+        if (retiredLeaves.size() >= RECLAIM_BATCH || retiredVersions.size() >= RECLAIM_BATCH) reclaim();
     }
 
-    // Admin menu
-    void showAdminMenu() {
-        std::cout << "\n" << std::string(50, '=') << std::endl;
-        std::cout << "    ADMIN PANEL" << std::endl;
-        std::cout << "    Welcome, " << currentAdmin->getName() << "!" << std::endl;
-        std::cout << std::string(50, '=') << std::endl;
-        std::cout << "1. Add Book" << std::endl;
-        std::cout << "2. View All Books" << std::endl;
-        std::cout << "3. Update Book" << std::endl;
-        std::cout << "4. Delete Book" << std::endl;
-        std::cout << "5. Issue Book" << std::endl;
-        std::cout << "6. Return Book" << std::endl;
-        std::cout << "7. Add User" << std::endl;
-        std::cout << "8. View All Users" << std::endl;
-        std::cout << "9. Search Books" << std::endl;
-        std::cout << "10. Logout" << std::endl;
-        std::cout << std::string(50, '=') << std::endl;
+    // Free what no pinned reader can reach any more
+    void reclaim() {
+        uint64_t oldest = std::numeric_limits<uint64_t>::max();
+        for (const ReaderSlot& reader : readers) {
+            uint64_t epoch = reader.epoch.load();
+            if (epoch != 0 && epoch < oldest) oldest = epoch;
+        }
+        freeRetired(retiredLeaves, oldest);
+        freeRetired(retiredBranches, oldest);
+        freeRetired(retiredVersions, oldest);
     }
 
-    // Run the system
-    void run() {
-        std::cout << "Welcome to the Library Management System!" << std::endl;
-        
-        while (true) {
-            try {
-                if (!isAdminLoggedIn()) {
-                    showMainMenu();
-                    int choice = getValidatedInput(1, 4);
+    // Lists are in epoch order, so the freeable nodes are a prefix
+    template <typename T>
+    void freeRetired(RetiredList<T>& retired, uint64_t oldestPinned) {
+        size_t done = 0;
+        while (done < retired.size() && retired[done].first <= oldestPinned) release(retired[done++].second);
+        retired.erase(retired.begin(), retired.begin() + done);
+    }
 
-                    switch (choice) {
-                        case 1: {
-                            std::string username, password;
-                            std::cout << "Enter username: ";
-                            std::cin >> username;
-                            std::cout << "Enter password: ";
+    template <typename T>
+    static void deleteAll(std::vector<T*>& nodes) {
+        for (T* node : nodes) delete node;
+        nodes.clear();
+    }
+
+public:
+    // Read-only view of one version. Releasing it (or destroying it) lets
+    // later writes free what only this version still used.
+    class Snapshot {
+    private:
+        ReaderSlot* reader;
+        const Version* version;
+
+        const Leaf* leafFor(size_t slot) const {
+            size_t branchIndex = slot / BRANCH_ROWS;
+            if (branchIndex >= version->branches.size() || !version->branches[branchIndex]) return nullptr;
+            return version->branches[branchIndex]->leaves[(slot / LEAF_ROWS) % BRANCH_LEAVES];
+        }
+
+        static const InternedString* column(const Leaf* leaf, BookStore::Field field) {
+            return field == BookStore::TITLE ? leaf->titles : field == BookStore::AUTHOR ? leaf->authors : leaf->isbns;
+        }
+
+        // Call fn(leaf, first slot) for every leaf in slot order
+        template <typename Fn>
+        void forEachLeaf(Fn fn) const {
+            for (size_t b = 0; b < version->branches.size(); ++b) {
+                const Branch* branch = version->branches[b];
+                if (!branch) continue;
+                for (size_t l = 0; l < BRANCH_LEAVES; ++l) {
+                    if (branch->leaves[l]) fn(branch->leaves[l], b * BRANCH_ROWS + l * LEAF_ROWS);
+                }
+            }
+        }
+
+        friend class CatalogVersions;
+        Snapshot(ReaderSlot* pinnedBy, const Version* pinned) : reader(pinnedBy), version(pinned) {}
+
+    public:
+        // Forward iterator over live slots in catalog order, like BookStore's
+        class LiveIterator {
+        private:
+            const Snapshot* snapshot;
+            size_t slot;
+
+            void skipHoles() {
+                while (slot < snapshot->slotCount() && !snapshot->isLive(slot)) ++slot;
+            }
+
+        public:
+            LiveIterator(const Snapshot* s, size_t pos) : snapshot(s), slot(pos) { skipHoles(); }
+            Book operator*() const { return (*snapshot)[slot]; }
+            LiveIterator& operator++() { ++slot; skipHoles(); return *this; }
+            bool operator!=(const LiveIterator& other) const { return slot != other.slot; }
+            bool operator==(const LiveIterator& other) const { return slot == other.slot; }
+        };
+
+        Snapshot() : reader(nullptr), version(nullptr) {}
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+        Snapshot(Snapshot&& other) noexcept : reader(other.reader), version(other.version) {
+            other.reader = nullptr;
+            other.version = nullptr;
+        }
+        Snapshot& operator=(Snapshot&& other) noexcept {
+            if (this != &other) {
+                release();
+                std::swap(reader, other.reader);
+                std::swap(version, other.version);
+            }
+            return *this;
+        }
+        ~Snapshot() { release(); }
+
+        void release() {
+            if (reader) reader->epoch.store(0);
+            reader = nullptr;
+            version = nullptr;
+        }
+
+        uint64_t epoch() const { return version->epoch; }
+        size_t slotCount() const { return version->slotCount; }
+        size_t size() const { return version->liveCount; }
+        bool empty() const { return version->liveCount == 0; }
+        size_t issuedCount() const { return version->issuedCount; }
+
+        bool isLive(size_t slot) const {
+            const Leaf* leaf = leafFor(slot);
+            return leaf && leaf->live[slot % LEAF_ROWS];
+        }
+
+        LiveIterator begin() const { return LiveIterator(this, 0); }
+        LiveIterator end() const { return LiveIterator(this, slotCount()); }
+
+        // Row accessors; the slot must be live
+        int bookId(size_t slot) const { return leafFor(slot)->ids[slot % LEAF_ROWS]; }
+        bool isIssued(size_t slot) const { return leafFor(slot)->issued[slot % LEAF_ROWS] != 0; }
+
+        std::string_view text(BookStore::Field field, size_t slot) const {
+            return column(leafFor(slot), field)[slot % LEAF_ROWS].view();
+        }
+
+        Book operator[](size_t slot) const {
+            const Leaf* leaf = leafFor(slot);
+            size_t row = slot % LEAF_ROWS;
+            return Book(leaf->ids[row], leaf->titles[row], leaf->authors[row], leaf->isbns[row],
+                        leaf->issued[row] != 0, leaf->issuedTo[row]);
+        }
+
+        // Call fn(slot) for every live slot in catalog order
+        template <typename Fn>
+        void forEachLive(Fn fn) const {
+            forEachLeaf([&](const Leaf* leaf, size_t base) {
+                for (size_t row = 0; row < LEAF_ROWS; ++row) {
+                    if (leaf->live[row]) fn(base + row);
+                }
+            });
+        }
+
+        // Call fn(slot, text) for every live slot in catalog order, reading one column
+        template <typename Fn>
+        void forEachText(BookStore::Field field, Fn fn) const {
+            forEachLeaf([&](const Leaf* leaf, size_t base) {
+                const InternedString* texts = column(leaf, field);
+                for (size_t row = 0; row < LEAF_ROWS; ++row) {
+                    if (leaf->live[row]) fn(base + row, texts[row].view());
+                }
+            });
+        }
+    };
+
+    // Changes made through any WriteScope are published together when the
+    // outermost one on the thread closes. Scopes nest; writers on other
+    // threads wait for the outermost to close.
+    class WriteScope {
+    private:
+        CatalogVersions& versions;
+
+    public:
+        explicit WriteScope(CatalogVersions& owner) : versions(owner) {
+            versions.writeMutex.lock();
+            ++versions.writeDepth;
+        }
+        ~WriteScope() {
+            if (--versions.writeDepth == 0) versions.publish();
+            versions.writeMutex.unlock();
+        }
+        WriteScope(const WriteScope&) = delete;
+        WriteScope& operator=(const WriteScope&) = delete;
+
+        void put(size_t slot, const Book& book) { versions.put(slot, book); }
+        void erase(size_t slot) { versions.erase(slot); }
+        void setIssued(size_t slot, bool isIssued, int userId) { versions.setIssued(slot, isIssued, userId); }
+        void assign(const BookStore& store) { versions.assign(store); }
+    };
+
+    CatalogVersions() : published(new Version{1, 0, 0, 0, {}}), publishedEpoch(1), writeDepth(0),
+                        working(nullptr), nodeBytes(0) {}
+    CatalogVersions(const CatalogVersions&) = delete;
+    CatalogVersions& operator=(const CatalogVersions&) = delete;
+
+    // Every snapshot must have been released
+    ~CatalogVersions() {
+        freeRetired(retiredLeaves, std::numeric_limits<uint64_t>::max());
+        freeRetired(retiredBranches, std::numeric_limits<uint64_t>::max());
+        freeRetired(retiredVersions, std::numeric_limits<uint64_t>::max());
+        Version* current = published.load();
+        for (Branch* branch : current->branches) {
+            if (!branch) continue;
+            for (Leaf* leaf : branch->leaves) {
+                if (leaf) release(leaf);
+            }
+            release(branch);
+        }
+        release(current);
+        deleteAll(freeLeaves);
+        deleteAll(freeBranches);
+        deleteAll(freeVersions);
+    }
+
+    // Pin the latest published version. Lock-free unless MAX_READERS
+    // snapshots are already held.
+    Snapshot pin() const {
+        size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+        for (size_t attempt = 0;; ++attempt) {
+            ReaderSlot& reader = readers[(start + attempt) % MAX_READERS];
+            uint64_t epoch = publishedEpoch.load();
+            uint64_t free = 0;
+            if (!reader.epoch.compare_exchange_strong(free, epoch)) {
+                if ((attempt + 1) % MAX_READERS == 0) std::this_thread::yield();
+                continue;
+            }
+            // A write may have published and scanned the pins in between; pin
+            // its version instead, until no publish slips through
+            for (uint64_t latest; (latest = publishedEpoch.load()) != epoch;) {
+                epoch = latest;
+                reader.epoch.store(epoch);
+            }
+            return Snapshot(&reader, published.load());
+        }
+    }
+
+    uint64_t epoch() const { return publishedEpoch.load(); }
+
+    size_t pinnedCount() const {
+        size_t count = 0;
+        for (const ReaderSlot& reader : readers) count += reader.epoch.load() != 0;
+        return count;
+    }
+
+    // Bytes of leaves and branches, including replaced ones not yet freed
+    size_t memoryUsage() const { return nodeBytes.load(std::memory_order_relaxed); }
+};
+
+// ASCII case-insensitive substring search. The SSE2 and AVX2 kernels compare
+// the needle's first and last bytes against 16 or 32 haystack positions at
+// once and verify the survivors; the fastest kernel the CPU supports is chosen
+// on first use. Needles must be folded with fold() beforehand, so a query is
+// lowercased once rather than once per book. Non-ASCII bytes compare exactly.
+class CaseFoldSearch {
+public:
+    typedef size_t (*FindFn)(std::string_view haystack, std::string_view foldedNeedle);
+
+    static unsigned char lower(unsigned char c) {
+        return static_cast<unsigned>(c - 'A') < 26u ? static_cast<unsigned char>(c | 0x20) : c;
+    }
+
+    static std::string fold(std::string_view text) {
+        std::string folded(text);
+        for (char& c : folded) c = static_cast<char>(lower(static_cast<unsigned char>(c)));
+        return folded;
+    }
+
+    static size_t findScalar(std::string_view haystack, std::string_view needle) {
+        size_t n = needle.size();
+        if (n == 0) return 0;
+        if (n > haystack.size()) return std::string_view::npos;
+        unsigned char first = static_cast<unsigned char>(needle[0]);
+        for (size_t i = 0; i + n <= haystack.size(); ++i) {
+            if (lower(static_cast<unsigned char>(haystack[i])) == first && matchesFrom(haystack.data() + i, needle, 1)) {
+                return i;
+            }
+        }
+        return std::string_view::npos;
+    }
+
+#ifdef LIBRARY_X86_SIMD
+    static size_t findSse2(std::string_view haystack, std::string_view needle) {
+        size_t n = needle.size();
+        if (n == 0) return 0;
+        if (n > haystack.size()) return std::string_view::npos;
+        const __m128i first = _mm_set1_epi8(needle[0]);
+        const __m128i last = _mm_set1_epi8(needle[n - 1]);
+        const char* h = haystack.data();
+        size_t limit = haystack.size() - n + 1;  // candidate start positions
+
+        size_t i = 0;
+        for (; i + 16 <= limit; i += 16) {
+            __m128i a = fold16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(h + i)));
+            __m128i b = fold16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(h + i + n - 1)));
+            unsigned mask = static_cast<unsigned>(
+                _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+            for (; mask; mask &= mask - 1) {
+                size_t pos = i + static_cast<size_t>(__builtin_ctz(mask));
+                if (matchesFrom(h + pos, needle, 1)) return pos;
+            }
+        }
+        if (i == limit) return std::string_view::npos;
+
+        // Fewer than 16 positions left: run one more block over a zero-padded copy
+        size_t rest = haystack.size() - i;
+        if (rest > TAIL_COPY_LIMIT) return offset(findScalar(haystack.substr(i), needle), i);
+        alignas(16) char tail[TAIL_COPY_LIMIT + 32] = {};
+        std::memcpy(tail, h + i, rest);
+        __m128i a = fold16(_mm_load_si128(reinterpret_cast<const __m128i*>(tail)));
+        __m128i b = fold16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tail + n - 1)));
+        unsigned mask = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+        mask &= (1u << (limit - i)) - 1;
+        for (; mask; mask &= mask - 1) {
+            size_t pos = static_cast<size_t>(__builtin_ctz(mask));
+            if (matchesFrom(tail + pos, needle, 1)) return i + pos;
+        }
+        return std::string_view::npos;
+    }
+
+    __attribute__((target("avx2")))
+    static size_t findAvx2(std::string_view haystack, std::string_view needle) {
+        size_t n = needle.size();
+        if (n == 0) return 0;
+        if (n > haystack.size()) return std::string_view::npos;
+        const __m256i first = _mm256_set1_epi8(needle[0]);
+        const __m256i last = _mm256_set1_epi8(needle[n - 1]);
+        const char* h = haystack.data();
+        size_t limit = haystack.size() - n + 1;
+
+        size_t i = 0;
+        for (; i + 32 <= limit; i += 32) {
+            __m256i a = fold32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(h + i)));
+            __m256i b = fold32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(h + i + n - 1)));
+            unsigned mask = static_cast<unsigned>(
+                _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))));
+            for (; mask; mask &= mask - 1) {
+                size_t pos = i + static_cast<size_t>(__builtin_ctz(mask));
+                if (matchesFrom(h + pos, needle, 1)) return pos;
+            }
+        }
+        if (i == limit) return std::string_view::npos;
+
+        size_t rest = haystack.size() - i;
+        if (rest > TAIL_COPY_LIMIT) return offset(findSse2(haystack.substr(i), needle), i);
+        alignas(32) char tail[TAIL_COPY_LIMIT + 32] = {};
+        std::memcpy(tail, h + i, rest);
+        __m256i a = fold32(_mm256_load_si256(reinterpret_cast<const __m256i*>(tail)));
+        __m256i b = fold32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(tail + n - 1)));
+        unsigned mask = static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))));
+        mask &= (1u << (limit - i)) - 1;
+        for (; mask; mask &= mask - 1) {
+            size_t pos = static_cast<size_t>(__builtin_ctz(mask));
+            if (matchesFrom(tail + pos, needle, 1)) return i + pos;
+        }
+        return std::string_view::npos;
+    }
+#endif
+
+    // Kernel used by find(), picked once from what the CPU supports
+    static FindFn bestKernel() {
+#ifdef LIBRARY_X86_SIMD
+        if (__builtin_cpu_supports("avx2")) return findAvx2;
+        return findSse2;
+#else
+        return findScalar;
+#endif
+    }
+
+    static const char* bestKernelName() {
+#ifdef LIBRARY_X86_SIMD
+        if (__builtin_cpu_supports("avx2")) return "avx2";
+        return "sse2";
+#else
+        return "scalar";
+#endif
+    }
+
+    static size_t find(std::string_view haystack, std::string_view foldedNeedle) {
+        static const FindFn kernel = bestKernel();
+        return kernel(haystack, foldedNeedle);
+    }
+
+private:
+    // Tails up to this long are copied into a padded buffer for one last vector step
+    static constexpr size_t TAIL_COPY_LIMIT = 64;
+
+    static bool matchesFrom(const char* text, std::string_view needle, size_t from) {
+        for (size_t j = from; j < needle.size(); ++j) {
+            if (lower(static_cast<unsigned char>(text[j])) != static_cast<unsigned char>(needle[j])) return false;
+        }
+        return true;
+    }
+
+    static size_t offset(size_t pos, size_t by) { return pos == std::string_view::npos ? pos : pos + by; }
+
+#ifdef LIBRARY_X86_SIMD
+    // Lowercase 'A'..'Z'; signed compares leave bytes >= 0x80 alone
+    static __m128i fold16(__m128i x) {
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(x, _mm_set1_epi8('Z' + 1)));
+        return _mm_or_si128(x, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+    }
+
+    __attribute__((target("avx2")))
+    static __m256i fold32(__m256i x) {
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8('A' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), x));
+        return _mm256_or_si256(x, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+    }
+#endif
+};
+
+// Trigram inverted index for substring search on one book field. Trigrams are
+// ASCII case-folded so one index serves case-sensitive and case-insensitive
+// queries; callers verify candidates against the text either way.
+class TrigramIndex {
+private:
+    // Posting lists of book IDs, kept sorted, keyed by packed trigram
+    std::unordered_map<uint32_t, std::vector<int>> postings;
+
+    static uint32_t packTrigram(std::string_view s, size_t pos) {
+        return (static_cast<uint32_t>(CaseFoldSearch::lower(static_cast<unsigned char>(s[pos]))) << 16) |
+               (static_cast<uint32_t>(CaseFoldSearch::lower(static_cast<unsigned char>(s[pos + 1]))) << 8) |
+               static_cast<uint32_t>(CaseFoldSearch::lower(static_cast<unsigned char>(s[pos + 2])));
+    }
+
+    // Distinct trigrams of a string, sorted
+    static std::vector<uint32_t> trigramsOf(std::string_view s) {
+        std::vector<uint32_t> grams;
+        if (s.size() < 3) return grams;
+        grams.reserve(s.size() - 2);
+        for (size_t i = 0; i + 2 < s.size(); ++i) {
+            grams.push_back(packTrigram(s, i));
+        }
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+        return grams;
+    }
+
+public:
+    // Queries shorter than this cannot use the index
+    static const size_t MIN_QUERY_LENGTH = 3;
+
+    void insert(int bookId, std::string_view text) {
+        for (uint32_t gram : trigramsOf(text)) {
+            std::vector<int>& list = postings[gram];
+            // IDs are mostly handed out in increasing order, so append is the common case
+            if (list.empty() || list.back() < bookId) {
+                list.push_back(bookId);
+            } else {
+                auto pos = std::lower_bound(list.begin(), list.end(), bookId);
+                if (pos == list.end() || *pos != bookId) list.insert(pos, bookId);
+            }
+        }
+    }
+
+    void remove(int bookId, std::string_view text) {
+        for (uint32_t gram : trigramsOf(text)) {
+            auto it = postings.find(gram);
+            if (it == postings.end()) continue;
+            std::vector<int>& list = it->second;
+            auto pos = std::lower_bound(list.begin(), list.end(), bookId);
+            if (pos != list.end() && *pos == bookId) list.erase(pos);
+            if (list.empty()) postings.erase(it);
+        }
+    }
+
+    void clear() {
+        postings.clear();
+    }
+
+    // Candidate book IDs (sorted) whose text contains every trigram of the query.
+    // Candidates are a superset of true matches and must be verified by the caller.
+    std::vector<int> candidates(std::string_view query) const {
+        std::vector<int> result;
+        std::vector<const std::vector<int>*> lists;
+        for (uint32_t gram : trigramsOf(query)) {
+            auto it = postings.find(gram);
+            if (it == postings.end()) return result;
+            lists.push_back(&it->second);
+        }
+        if (lists.empty()) return result;
+
+        // Intersect starting from the shortest posting list
+        std::sort(lists.begin(), lists.end(),
+                  [](const std::vector<int>* a, const std::vector<int>* b) { return a->size() < b->size(); });
+        result = *lists[0];
+        std::vector<int> scratch;
+        for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+            scratch.clear();
+            const std::vector<int>& list = *lists[i];
+            if (result.size() * 16 < list.size()) {
+                // Few candidates against a long list: probe by binary search
+                auto from = list.begin();
+                for (int id : result) {
+                    from = std::lower_bound(from, list.end(), id);
+                    if (from == list.end()) break;
+                    if (*from == id) scratch.push_back(id);
+                }
+            } else {
+                std::set_intersection(result.begin(), result.end(), list.begin(), list.end(),
+                                      std::back_inserter(scratch));
+            }
+            result.swap(scratch);
+        }
+        return result;
+    }
+
+    // IDs, ascending, of books that could contain the query within `edits`
+    // edits. An insertion, deletion, substitution or adjacent swap spoils at
+    // most four of the query's trigrams, so a match keeps all but 4 * edits of
+    // them. Returns false when that bound rules nothing out and the caller has
+    // to scan instead.
+    bool fuzzyCandidates(std::string_view query, int edits, std::vector<int>& ids) const {
+        ids.clear();
+        std::vector<uint32_t> grams = trigramsOf(query);
+        size_t spoiled = 4 * static_cast<size_t>(edits);
+        if (grams.size() <= spoiled || grams.size() > UINT8_MAX) return false;
+        size_t needed = grams.size() - spoiled;
+
+        typedef std::pair<const int*, const int*> Cursor;
+        std::vector<Cursor> lists;
+        for (uint32_t gram : grams) {
+            auto it = postings.find(gram);
+            if (it != postings.end()) lists.emplace_back(it->second.data(), it->second.data() + it->second.size());
+        }
+        if (lists.size() < needed) return true;
+
+        // A qualifying ID is in at least one of the shortest (lists - needed + 1)
+        // lists. Count IDs across those in a dense array, then probe the long
+        // lists by binary search only for IDs still short of the bound.
+        std::sort(lists.begin(), lists.end(), [](const Cursor& a, const Cursor& b) {
+            return a.second - a.first < b.second - b.first;
+        });
+        size_t counted = lists.size() - needed + 1;
+        int maxId = 0;
+        for (size_t i = 0; i < counted; ++i) maxId = std::max(maxId, *(lists[i].second - 1));
+        std::vector<uint8_t> shared(static_cast<size_t>(maxId) + 1);
+        std::vector<int> seen;
+        for (size_t i = 0; i < counted; ++i) {
+            for (const int* id = lists[i].first; id != lists[i].second; ++id) {
+                if (shared[*id]++ == 0) seen.push_back(*id);
+            }
+        }
+        for (int id : seen) {
+            size_t count = shared[id];
+            for (size_t i = counted; i < lists.size() && count < needed && count + (lists.size() - i) >= needed; ++i) {
+                count += std::binary_search(lists[i].first, lists[i].second, id);
+            }
+            if (count >= needed) ids.push_back(id);
+        }
+        std::sort(ids.begin(), ids.end());
+        return true;
+    }
+
+    size_t trigramCount() const { return postings.size(); }
+
+    // Approximate heap footprint in bytes
+    size_t memoryUsage() const {
+        size_t bytes = postings.bucket_count() * sizeof(void*);
+        for (const auto& entry : postings) {
+            // Node: next pointer + cached hash + key/value pair
+            bytes += 2 * sizeof(void*) + sizeof(entry);
+            bytes += entry.second.capacity() * sizeof(int);
+        }
+        return bytes;
+    }
+};
+
+// Prefix completion over one text field, for type-ahead. Distinct texts are
+// kept in a sorted array ordered by ASCII case-folded text, each with the
+// number of books using it. New texts go to a small sorted side array that is
+// merged in once it fills; texts whose count drops to zero stay in place until
+// the next merge. Bulk loads append unsorted and sort once at the end.
+class PrefixIndex {
+private:
+    struct Entry {
+        InternedString text;
+        uint32_t key;    // first four folded bytes, so most comparisons skip the text
+        uint32_t count;  // books with this text; 0 once all are gone
+    };
+
+    std::vector<Entry> sorted;
+    std::vector<Entry> recent;
+    size_t emptyEntries = 0;
+    bool bulkLoading = false;
+
+    static constexpr size_t RECENT_LIMIT = 4096;
+
+    // Leading folded bytes, big-endian and zero padded: comparing keys orders
+    // texts the same way as compareFolded whenever the keys differ
+    static uint32_t foldedKey(std::string_view text) {
+        uint32_t key = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            key <<= 8;
+            if (i < text.size()) key |= CaseFoldSearch::lower(static_cast<unsigned char>(text[i]));
+        }
+        return key;
+    }
+
+    static Entry makeEntry(InternedString text, uint32_t count) { return Entry{text, foldedKey(text.view()), count}; }
+
+    static int compareFolded(std::string_view a, std::string_view b) {
+        size_t n = std::min(a.size(), b.size());
+        for (size_t i = 0; i < n; ++i) {
+            unsigned char x = CaseFoldSearch::lower(static_cast<unsigned char>(a[i]));
+            unsigned char y = CaseFoldSearch::lower(static_cast<unsigned char>(b[i]));
+            if (x != y) return x < y ? -1 : 1;
+        }
+        return a.size() < b.size() ? -1 : a.size() > b.size() ? 1 : 0;
+    }
+
+    // Folded order, then raw bytes, so each text has exactly one position
+    static bool entryLess(const Entry& a, const Entry& b) {
+        if (a.key != b.key) return a.key < b.key;
+        int folded = compareFolded(a.text.view(), b.text.view());
+        return folded != 0 ? folded < 0 : a.text.view() < b.text.view();
+    }
+
+    static Entry* find(std::vector<Entry>& entries, InternedString text) {
+        auto it = std::lower_bound(entries.begin(), entries.end(), makeEntry(text, 0), entryLess);
+        return it != entries.end() && it->text == text ? &*it : nullptr;
+    }
+
+    // First entry whose folded text is not below the folded prefix
+    static std::vector<Entry>::const_iterator seek(const std::vector<Entry>& entries, std::string_view prefix) {
+        uint32_t key = foldedKey(prefix);
+        return std::lower_bound(entries.begin(), entries.end(), prefix, [key](const Entry& e, std::string_view p) {
+            return e.key != key ? e.key < key : compareFolded(e.text.view(), p) < 0;
+        });
+    }
+
+    static bool startsWith(std::string_view text, std::string_view prefix) {
+        return text.size() >= prefix.size() && compareFolded(text.substr(0, prefix.size()), prefix) == 0;
+    }
+
+    // Fold runs of the same text together, dropping texts no book uses
+    void coalesce() {
+        size_t out = 0;
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            if (out > 0 && sorted[out - 1].text == sorted[i].text) {
+                sorted[out - 1].count += sorted[i].count;
+            } else {
+                sorted[out++] = sorted[i];
+            }
+        }
+        sorted.resize(out);
+        sorted.erase(std::remove_if(sorted.begin(), sorted.end(), [](const Entry& e) { return e.count == 0; }),
+                     sorted.end());
+        emptyEntries = 0;
+    }
+
+    void mergeRecent() {
+        size_t middle = sorted.size();
+        sorted.insert(sorted.end(), recent.begin(), recent.end());
+        recent.clear();
+        std::inplace_merge(sorted.begin(), sorted.begin() + middle, sorted.end(), entryLess);
+        coalesce();
+    }
+
+public:
+    void insert(InternedString text) {
+        if (bulkLoading) {
+            sorted.push_back(makeEntry(text, 1));
+            return;
+        }
+        if (Entry* entry = find(sorted, text)) {
+            if (entry->count++ == 0) --emptyEntries;
+            return;
+        }
+        if (Entry* entry = find(recent, text)) {
+            ++entry->count;
+            return;
+        }
+        Entry added = makeEntry(text, 1);
+        recent.insert(std::upper_bound(recent.begin(), recent.end(), added, entryLess), added);
+        if (recent.size() >= RECENT_LIMIT) mergeRecent();
+    }
+
+    void remove(InternedString text) {
+        if (Entry* entry = find(recent, text)) {
+            if (--entry->count == 0) recent.erase(recent.begin() + (entry - recent.data()));
+            return;
+        }
+        Entry* entry = find(sorted, text);
+        if (!entry || entry->count == 0) return;
+        if (--entry->count == 0 && ++emptyEntries > sorted.size() / 4) mergeRecent();
+    }
+
+    // Inserts until endBulkLoad() skip lookups; no queries in between
+    void beginBulkLoad() {
+        if (!recent.empty()) mergeRecent();
+        bulkLoading = true;
+    }
+
+    void endBulkLoad() {
+        bulkLoading = false;
+        std::stable_sort(sorted.begin(), sorted.end(), entryLess);
+        coalesce();
+    }
+
+    // Up to `limit` distinct texts starting with the prefix, ignoring ASCII
+    // case, in case-folded alphabetical order. Texts differing only in case
+    // are reported once.
+    std::vector<std::string_view> complete(std::string_view prefix, size_t limit) const {
+        std::vector<std::string_view> result;
+        auto a = seek(sorted, prefix), aEnd = sorted.end();
+        auto b = seek(recent, prefix), bEnd = recent.end();
+        while (result.size() < limit) {
+            bool haveA = a != aEnd && startsWith(a->text.view(), prefix);
+            bool haveB = b != bEnd && startsWith(b->text.view(), prefix);
+            if (!haveA && !haveB) break;
+            const Entry& next = !haveB || (haveA && entryLess(*a, *b)) ? *a++ : *b++;
+            if (next.count == 0) continue;
+            if (!result.empty() && compareFolded(result.back(), next.text.view()) == 0) continue;
+            result.push_back(next.text.view());
+        }
+        return result;
+    }
+
+    size_t size() const { return sorted.size() - emptyEntries + recent.size(); }
+
+    size_t memoryUsage() const { return (sorted.capacity() + recent.capacity()) * sizeof(Entry); }
+
+    void clear() {
+        sorted.clear();
+        recent.clear();
+        emptyEntries = 0;
+    }
+};
+
+// Typo-tolerant substring matcher: the fewest insertions, deletions,
+// substitutions or adjacent swaps that turn the pattern into some substring of
+// a text, ignoring ASCII case. Bit-parallel (Myers, with Hyyrö's transposition
+// term), so each text byte costs a few word operations. Patterns longer than
+// 64 bytes are cut to their first 64.
+class FuzzyMatcher {
+private:
+    uint64_t peq[256];  // bit i set where pattern[i] matches the byte
+    size_t length;
+    uint64_t lastBit;
+
+public:
+    static constexpr size_t MAX_PATTERN_LENGTH = 64;
+
+    explicit FuzzyMatcher(std::string_view pattern) : length(std::min(pattern.size(), MAX_PATTERN_LENGTH)) {
+        std::fill(std::begin(peq), std::end(peq), 0);
+        for (size_t i = 0; i < length; ++i) {
+            unsigned char c = CaseFoldSearch::lower(static_cast<unsigned char>(pattern[i]));
+            peq[c] |= 1ULL << i;
+            if (c >= 'a' && c <= 'z') peq[c - 'a' + 'A'] |= 1ULL << i;
+        }
+        lastBit = length > 0 ? 1ULL << (length - 1) : 0;
+    }
+
+    size_t patternLength() const { return length; }
+
+    // Smallest edit distance between the pattern and any substring of the text
+    int distance(std::string_view text) const {
+        int current = static_cast<int>(length);
+        int best = current;
+        uint64_t vp = ~0ULL, vn = 0, d0 = 0, previousEq = 0;
+        for (size_t j = 0; j < text.size() && best > 0; ++j) {
+            uint64_t eq = peq[static_cast<unsigned char>(text[j])];
+            uint64_t swapped = ((~d0 & eq) << 1) & previousEq;
+            d0 = (((eq & vp) + vp) ^ vp) | eq | vn | swapped;
+            uint64_t hp = vn | ~(d0 | vp);
+            uint64_t hn = d0 & vp;
+            if (hp & lastBit) {
+                ++current;
+            } else if (hn & lastBit) {
+                --current;
+            }
+            // A match may start anywhere, so no carry into the first row
+            hp <<= 1;
+            hn <<= 1;
+            vp = hn | ~(d0 | hp);
+            vn = hp & d0;
+            previousEq = eq;
+            best = std::min(best, current);
+        }
+        return best;
+    }
+};
+
+// ISBN-10 or ISBN-13 as a 64-bit key: the ISBN-13 digits read as a number.
+// Hyphens and spaces are ignored and ISBN-10s are converted to their 978
+// ISBN-13. Returns 0 when the text is not an ISBN or its check digit is wrong;
+// 13-digit codes outside the 978/979 book prefixes are other EANs, not ISBNs.
+inline uint64_t isbnKey(std::string_view text) {
+    int digits[13];
+    size_t count = 0;
+    for (char c : text) {
+        if (c == '-' || c == ' ') continue;
+        if (count == 13) return 0;
+        if (c >= '0' && c <= '9') {
+            digits[count++] = c - '0';
+        } else if ((c == 'X' || c == 'x') && count == 9) {
+            digits[count++] = 10;  // ISBN-10 check digit only
+        } else {
+            return 0;
+        }
+    }
+
+    if (count == 10) {
+        int sum = 0;
+        for (size_t i = 0; i < 10; ++i) sum += static_cast<int>(10 - i) * digits[i];
+        if (sum % 11 != 0) return 0;
+        // Shift the nine body digits behind a 978 prefix and recompute the check digit
+        for (size_t i = 9; i-- > 0;) digits[i + 3] = digits[i];
+        digits[0] = 9;
+        digits[1] = 7;
+        digits[2] = 8;
+        sum = 0;
+        for (size_t i = 0; i < 12; ++i) sum += digits[i] * (i % 2 ? 3 : 1);
+        digits[12] = (10 - sum % 10) % 10;
+    } else if (count == 13) {
+        if (digits[0] != 9 || digits[1] != 7 || (digits[2] != 8 && digits[2] != 9)) return 0;
+        int sum = 0;
+        for (size_t i = 0; i < 13; ++i) {
+            if (digits[i] > 9) return 0;
+            sum += digits[i] * (i % 2 ? 3 : 1);
+        }
+        if (sum % 10 != 0) return 0;
+    } else {
+        return 0;
+    }
+
+    uint64_t key = 0;
+    for (int digit : digits) key = key * 10 + static_cast<uint64_t>(digit);
+    return key;
+}
+
+// Flat open-addressing multimap from ISBN key to book ID: linear probing over
+// a power-of-two table kept at most half full. Duplicate ISBNs get one entry
+// each. Removed entries become tombstones, which are dropped on the next resize.
+class IsbnIndex {
+private:
+    struct Entry {
+        uint64_t key;
+        int bookId;
+    };
+
+    // Valid ISBN-13 keys start at 978 followed by ten digits, so 0 and 1 are free markers
+    static constexpr uint64_t EMPTY = 0;
+    static constexpr uint64_t REMOVED = 1;
+
+    std::vector<Entry> table;
+    size_t liveCount = 0;
+    size_t usedCount = 0;  // live entries plus tombstones
+
+    static size_t hash(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return static_cast<size_t>(key);
+    }
+
+    void rehash(size_t minLive) {
+        size_t capacity = 16;
+        while (capacity < minLive * 2) capacity <<= 1;
+        std::vector<Entry> old(capacity, Entry{EMPTY, 0});
+        old.swap(table);
+        usedCount = liveCount;
+        size_t mask = table.size() - 1;
+        for (const Entry& entry : old) {
+            if (entry.key == EMPTY || entry.key == REMOVED) continue;
+            size_t i = hash(entry.key) & mask;
+            while (table[i].key != EMPTY) i = (i + 1) & mask;
+            table[i] = entry;
+        }
+    }
+
+public:
+    void insert(uint64_t key, int bookId) {
+        if ((usedCount + 1) * 2 > table.size()) rehash(std::max<size_t>(liveCount + 1, liveCount * 2));
+        size_t mask = table.size() - 1;
+        size_t i = hash(key) & mask;
+        while (table[i].key != EMPTY && table[i].key != REMOVED) i = (i + 1) & mask;
+        if (table[i].key == EMPTY) ++usedCount;
+        table[i] = Entry{key, bookId};
+        ++liveCount;
+    }
+
+    void erase(uint64_t key, int bookId) {
+        if (table.empty()) return;
+        size_t mask = table.size() - 1;
+        for (size_t i = hash(key) & mask; table[i].key != EMPTY; i = (i + 1) & mask) {
+            if (table[i].key == key && table[i].bookId == bookId) {
+                table[i].key = REMOVED;
+                --liveCount;
+                return;
+            }
+        }
+    }
+
+    // Call fn(bookId) for every book with this key
+    template <typename Fn>
+    void forEach(uint64_t key, Fn fn) const {
+        if (table.empty()) return;
+        size_t mask = table.size() - 1;
+        for (size_t i = hash(key) & mask; table[i].key != EMPTY; i = (i + 1) & mask) {
+            if (table[i].key == key) fn(table[i].bookId);
+        }
+    }
+
+    // Some book with this key other than `exceptBookId`, or -1
+    int findOther(uint64_t key, int exceptBookId) const {
+        int found = -1;
+        forEach(key, [&](int bookId) {
+            if (found < 0 && bookId != exceptBookId) found = bookId;
+        });
+        return found;
+    }
+
+    void reserve(size_t n) {
+        if (n * 2 > table.size()) rehash(std::max(n, liveCount));
+    }
+
+    size_t size() const { return liveCount; }
+    size_t memoryUsage() const { return table.capacity() * sizeof(Entry); }
+};
+
+// User ID to users-table index. IDs are handed out sequentially, so they live
+// in a direct-indexed array; IDs far past the end (gaps left by imported data)
+// or negative go to a hash map instead, and move into the array once it grows
+// to cover them. Entries are removed only when adding a user is rolled back.
+class UserIndex {
+private:
+    static constexpr int NONE = -1;
+    // An ID joins the array when that leaves it at least about half full
+    static constexpr size_t DENSE_SLACK = 1024;
+
+    std::vector<int> dense;
+    std::unordered_map<int, int> sparse;
+    size_t count = 0;
+
+    bool fitsDense(int userId) const {
+        return userId >= 0 && static_cast<size_t>(userId) < 2 * (count + 1) + DENSE_SLACK;
+    }
+
+    // Extend the array to cover userId, doubling it where the fill limit
+    // allows, so appending IDs one by one resizes it only O(log n) times.
+    // Sparse entries move over only from the newly covered range.
+    void growDense(int userId) {
+        size_t oldSize = dense.size();
+        size_t limit = 2 * (count + 1) + DENSE_SLACK;
+        size_t newSize = std::min(std::max(static_cast<size_t>(userId) + 1, 2 * oldSize), limit);
+        dense.resize(newSize, NONE);
+        if (sparse.empty()) return;
+        if (sparse.size() <= newSize - oldSize) {
+            for (auto it = sparse.begin(); it != sparse.end();) {
+                if (it->first >= 0 && static_cast<size_t>(it->first) >= oldSize &&
+                    static_cast<size_t>(it->first) < newSize) {
+                    dense[it->first] = it->second;
+                    it = sparse.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        } else {
+            for (size_t id = oldSize; id < newSize; ++id) {
+                auto it = sparse.find(static_cast<int>(id));
+                if (it == sparse.end()) continue;
+                dense[id] = it->second;
+                sparse.erase(it);
+            }
+        }
+    }
+
+public:
+    // Table index of the user, or -1
+    int find(int userId) const {
+        if (static_cast<unsigned>(userId) < dense.size()) return dense[userId];
+        if (sparse.empty()) return NONE;
+        auto it = sparse.find(userId);
+        return it == sparse.end() ? NONE : it->second;
+    }
+
+    void insert(int userId, int index) {
+        if (static_cast<unsigned>(userId) >= dense.size() && fitsDense(userId)) {
+            growDense(userId);
+        }
+        if (static_cast<unsigned>(userId) < dense.size()) {
+            if (dense[userId] == NONE) ++count;
+            dense[userId] = index;
+        } else {
+            if (sparse.insert_or_assign(userId, index).second) ++count;
+        }
+    }
+
+    void erase(int userId) {
+        if (static_cast<unsigned>(userId) < dense.size()) {
+            if (dense[userId] != NONE) --count;
+            dense[userId] = NONE;
+        } else {
+            count -= sparse.erase(userId);
+        }
+    }
+
+    void reserve(size_t n) { dense.reserve(n); }
+
+    size_t size() const { return count; }
+    size_t sparseSize() const { return sparse.size(); }
+    size_t memoryUsage() const {
+        return dense.capacity() * sizeof(int) + sparse.size() * (sizeof(std::pair<const int, int>) + 2 * sizeof(void*));
+    }
+};
+
+// Calendar date of a Unix time in local time, as YYYY-MM-DD ("-" for unknown)
+inline std::string formatDate(int64_t seconds) {
+    if (seconds <= 0) return "-";
+    std::time_t time = static_cast<std::time_t>(seconds);
+    std::tm parts{};
+    char text[16];
+    if (!localtime_r(&time, &parts) || std::strftime(text, sizeof(text), "%Y-%m-%d", &parts) == 0) return "-";
+    return text;
+}
+
+// One loan of a book to a user. Times are Unix seconds; an issue time of 0
+// means unknown (a loan adopted from data older than the ledger).
+struct Loan {
+    int loanId = 0;
+    int bookId = 0;
+    int userId = 0;
+    int64_t issuedAt = 0;
+    int64_t dueAt = 0;
+    int64_t returnedAt = 0;  // 0 while the loan is open
+
+    bool isOpen() const { return returnedAt == 0; }
+
+    // loans.txt row: loanId,bookId,userId,issuedAt,dueAt,returnedAt
+    void appendFileString(std::string& out) const {
+        appendInt(out, loanId);
+        out += ',';
+        appendInt(out, bookId);
+        out += ',';
+        appendInt(out, userId);
+        out += ',';
+        appendInt(out, issuedAt);
+        out += ',';
+        appendInt(out, dueAt);
+        out += ',';
+        appendInt(out, returnedAt);
+    }
+
+    bool fromFileString(std::string_view line) {
+        std::string_view fields[6];
+        if (splitFields(line, ',', fields, 6) != 6) return false;
+        Loan loan;
+        if (!parseInt(fields[0], loan.loanId) || !parseInt(fields[1], loan.bookId) ||
+            !parseInt(fields[2], loan.userId) || !parseInt(fields[3], loan.issuedAt) ||
+            !parseInt(fields[4], loan.dueAt) || !parseInt(fields[5], loan.returnedAt) || loan.loanId <= 0 ||
+            loan.returnedAt < 0) {
+            return false;
+        }
+        *this = loan;
+        return true;
+    }
+};
+
+// Every loan ever made, by loan ID, with the open ones in a min-heap on due
+// date so that the loans overdue at any time are found in O(overdue) without
+// looking at the catalog. Issue and return run under the shared catalog lock,
+// so the ledger has its own mutex, taken after the book and user stripes.
+class LoanLedger {
+private:
+    static constexpr int NOT_IN_HEAP = -1;
+    // Loan IDs further than this past the last one are treated as corrupt
+    static constexpr size_t MAX_ID_GAP = 1 << 20;
+
+    mutable std::mutex mtx;
+    std::vector<Loan> loans;         // loans[id - 1]; loanId 0 marks an unused ID
+    std::vector<int> heapPos;        // position of each open loan in `heap`
+    std::vector<int> heap;           // open loan IDs, earliest due first
+    std::unordered_map<int, int> openByBook;
+    size_t loanCount = 0;
+
+    Loan& at(int loanId) { return loans[loanId - 1]; }
+    const Loan& at(int loanId) const { return loans[loanId - 1]; }
+
+    bool earlier(int a, int b) const {
+        const Loan& x = at(a);
+        const Loan& y = at(b);
+        return x.dueAt != y.dueAt ? x.dueAt < y.dueAt : a < b;
+    }
+
+    void place(size_t pos, int loanId) {
+        heap[pos] = loanId;
+        heapPos[loanId - 1] = static_cast<int>(pos);
+    }
+
+    void siftUp(size_t pos) {
+        int loanId = heap[pos];
+        while (pos > 0) {
+            size_t parent = (pos - 1) / 2;
+            if (!earlier(loanId, heap[parent])) break;
+            place(pos, heap[parent]);
+            pos = parent;
+        }
+        place(pos, loanId);
+    }
+
+    void siftDown(size_t pos) {
+        int loanId = heap[pos];
+        while (true) {
+            size_t child = 2 * pos + 1;
+            if (child >= heap.size()) break;
+            if (child + 1 < heap.size() && earlier(heap[child + 1], heap[child])) ++child;
+            if (!earlier(heap[child], loanId)) break;
+            place(pos, heap[child]);
+            pos = child;
+        }
+        place(pos, loanId);
+    }
+
+    void heapRemove(int loanId) {
+        size_t pos = static_cast<size_t>(heapPos[loanId - 1]);
+        heapPos[loanId - 1] = NOT_IN_HEAP;
+        int last = heap.back();
+        heap.pop_back();
+        if (last == loanId) return;
+        place(pos, last);
+        siftDown(pos);
+        siftUp(static_cast<size_t>(heapPos[last - 1]));
+    }
+
+    void closeLocked(int loanId, int64_t returnedAt) {
+        Loan& loan = at(loanId);
+        loan.returnedAt = std::max<int64_t>(returnedAt, 1);
+        heapRemove(loanId);
+        auto it = openByBook.find(loan.bookId);
+        if (it != openByBook.end() && it->second == loanId) openByBook.erase(it);
+    }
+
+    void insertLocked(const Loan& loan) {
+        if (static_cast<size_t>(loan.loanId) > loans.size()) {
+            loans.resize(loan.loanId);
+            heapPos.resize(loan.loanId, NOT_IN_HEAP);
+        }
+        Loan& stored = at(loan.loanId);
+        stored = loan;
+        ++loanCount;
+        if (!loan.isOpen()) return;
+        // A book has at most one open loan; the later of two ends the earlier
+        auto it = openByBook.find(loan.bookId);
+        if (it != openByBook.end()) {
+            if (it->second > loan.loanId) {
+                stored.returnedAt = std::max<int64_t>(at(it->second).issuedAt, 1);
+                return;
+            }
+            closeLocked(it->second, loan.issuedAt);
+        }
+        openByBook[loan.bookId] = loan.loanId;
+        heap.push_back(loan.loanId);
+        siftUp(heap.size() - 1);
+    }
+
+public:
+    // Record a new open loan and return its ID
+    int open(int bookId, int userId, int64_t issuedAt, int64_t dueAt) {
+        std::lock_guard<std::mutex> lock(mtx);
+        Loan loan;
+        loan.loanId = static_cast<int>(loans.size() + 1);
+        loan.bookId = bookId;
+        loan.userId = userId;
+        loan.issuedAt = issuedAt;
+        loan.dueAt = dueAt;
+        insertLocked(loan);
+        return loan.loanId;
+    }
+
+    // Add a loan with its ID, as read back from loans.txt or the journal.
+    // An ID already present is left alone, so replaying a record is harmless.
+    bool insert(const Loan& loan) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (loan.loanId <= 0 || static_cast<size_t>(loan.loanId) > loans.size() + MAX_ID_GAP) return false;
+        if (static_cast<size_t>(loan.loanId) <= loans.size() && at(loan.loanId).loanId != 0) return true;
+        insertLocked(loan);
+        return true;
+    }
+
+    // Close a loan if it is open
+    void close(int loanId, int64_t returnedAt) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (loanId <= 0 || static_cast<size_t>(loanId) > loans.size()) return;
+        if (at(loanId).loanId != 0 && at(loanId).isOpen()) closeLocked(loanId, returnedAt);
+    }
+
+    // Forget a loan whose issue is being rolled back. Its ID is not reused.
+    void discard(int loanId) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (loanId <= 0 || static_cast<size_t>(loanId) > loans.size() || at(loanId).loanId == 0) return;
+        Loan& loan = at(loanId);
+        if (loan.isOpen()) {
+            heapRemove(loanId);
+            auto it = openByBook.find(loan.bookId);
+            if (it != openByBook.end() && it->second == loanId) openByBook.erase(it);
+        }
+        loan = Loan();
+        --loanCount;
+    }
+
+    // Open a loan again whose return is being rolled back
+    void reopen(int loanId) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (loanId <= 0 || static_cast<size_t>(loanId) > loans.size() || at(loanId).loanId == 0) return;
+        Loan& loan = at(loanId);
+        if (loan.isOpen()) return;
+        loan.returnedAt = 0;
+        openByBook[loan.bookId] = loanId;
+        heap.push_back(loanId);
+        siftUp(heap.size() - 1);
+    }
+
+    // Close the open loan of a book and return its ID, or 0 if there is none
+    int closeOpenFor(int bookId, int64_t returnedAt) {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = openByBook.find(bookId);
+        if (it == openByBook.end()) return 0;
+        int loanId = it->second;
+        closeLocked(loanId, returnedAt);
+        return loanId;
+    }
+
+    // The open loan of a book, if any
+    bool openLoanFor(int bookId, Loan& loan) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = openByBook.find(bookId);
+        if (it == openByBook.end()) return false;
+        loan = at(it->second);
+        return true;
+    }
+
+    // Open loans due before `asOf`, earliest first. Only heap entries due
+    // before `asOf` and their direct children are visited.
+    std::vector<Loan> dueBefore(int64_t asOf) const {
+        std::vector<Loan> due;
+        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<size_t> pending;
+        if (!heap.empty()) pending.push_back(0);
+        while (!pending.empty()) {
+            size_t pos = pending.back();
+            pending.pop_back();
+            const Loan& loan = at(heap[pos]);
+            if (loan.dueAt >= asOf) continue;
+            due.push_back(loan);
+            if (2 * pos + 1 < heap.size()) pending.push_back(2 * pos + 1);
+            if (2 * pos + 2 < heap.size()) pending.push_back(2 * pos + 2);
+        }
+        std::sort(due.begin(), due.end(), [](const Loan& a, const Loan& b) {
+            return a.dueAt != b.dueAt ? a.dueAt < b.dueAt : a.loanId < b.loanId;
+        });
+        return due;
+    }
+
+    // Call fn(loan) for every open loan, in no particular order
+    template <typename Fn>
+    void forEachOpen(Fn fn) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (int loanId : heap) fn(at(loanId));
+    }
+
+    // Call fn(loan) for every loan, open or closed, in ID order
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const Loan& loan : loans) {
+            if (loan.loanId != 0) fn(loan);
+        }
+    }
+
+    // Copy the loan table (including unused IDs) for serializing outside the lock
+    void copyTo(std::vector<Loan>& out) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        out = loans;
+    }
+
+    // Append a copied loan table in loans.txt format
+    static void serialize(const std::vector<Loan>& table, std::string& out) {
+        for (const Loan& loan : table) {
+            if (loan.loanId == 0) continue;
+            loan.appendFileString(out);
+            out += '\n';
+        }
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return loanCount;
+    }
+
+    size_t openCount() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return heap.size();
+    }
+
+    size_t memoryUsage() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return loans.capacity() * sizeof(Loan) + heapPos.capacity() * sizeof(int) + heap.capacity() * sizeof(int) +
+               openByBook.size() * (sizeof(std::pair<const int, int>) + 2 * sizeof(void*));
+    }
+};
+
+// A patron waiting for a book that is on loan
+struct Hold {
+    int holdId = 0;
+    int bookId = 0;
+    int userId = 0;
+    int64_t placedAt = 0;
+
+    // holds.txt row: holdId,bookId,userId,placedAt
+    void appendFileString(std::string& out) const {
+        appendInt(out, holdId);
+        out += ',';
+        appendInt(out, bookId);
+        out += ',';
+        appendInt(out, userId);
+        out += ',';
+        appendInt(out, placedAt);
+    }
+
+    bool fromFileString(std::string_view line) {
+        std::string_view fields[4];
+        if (splitFields(line, ',', fields, 4) != 4) return false;
+        Hold hold;
+        if (!parseInt(fields[0], hold.holdId) || !parseInt(fields[1], hold.bookId) ||
+            !parseInt(fields[2], hold.userId) || !parseInt(fields[3], hold.placedAt) || hold.holdId <= 0) {
+            return false;
+        }
+        *this = hold;
+        return true;
+    }
+};
+
+// FIFO hold queues, one per book, threaded through a single node pool. Each
+// node is linked into its book's queue and into its patron's list, so placing
+// a hold, cancelling it by ID and taking the head of a queue are O(1) and only
+// reuse pooled nodes. Hold IDs are never reused; a dense table maps them to
+// nodes. Like the loan ledger it has its own mutex, taken after the stripes.
+class HoldQueues {
+private:
+    static constexpr int NIL = -1;
+    static constexpr int ENDED = -2;  // in holdSlots: the hold was filled or cancelled
+    // Hold IDs further than this past the last one are treated as corrupt
+    static constexpr size_t MAX_ID_GAP = 1 << 20;
+
+    struct Node {
+        Hold hold;
+        int prev = NIL;  // within the book's queue; `next` also links the free list
+        int next = NIL;
+        int userPrev = NIL;
+        int userNext = NIL;
+    };
+
+    struct Queue {
+        int head = NIL;
+        int tail = NIL;
+        size_t length = 0;
+    };
+
+    mutable std::mutex mtx;
+    std::vector<Node> nodes;
+    int freeList = NIL;
+    std::vector<int> holdSlots;  // holdSlots[id - 1]: node, NIL if never seen, or ENDED
+    std::unordered_map<int, Queue> queues;
+    std::unordered_map<int, int> userHeads;
+    size_t active = 0;
+
+    int allocate() {
+        if (freeList == NIL) {
+            nodes.emplace_back();
+            return static_cast<int>(nodes.size() - 1);
+        }
+        int slot = freeList;
+        freeList = nodes[slot].next;
+        nodes[slot] = Node();
+        return slot;
+    }
+
+    // Add a node to its book's line just ahead of `before`, or at the back
+    void link(int slot, int before = NIL) {
+        Node& node = nodes[slot];
+        Queue& queue = queues[node.hold.bookId];
+        node.prev = before == NIL ? queue.tail : nodes[before].prev;
+        node.next = before;
+        if (node.prev != NIL) nodes[node.prev].next = slot; else queue.head = slot;
+        if (before != NIL) nodes[before].prev = slot; else queue.tail = slot;
+        ++queue.length;
+
+        auto head = userHeads.try_emplace(node.hold.userId, NIL).first;
+        node.userNext = head->second;
+        if (head->second != NIL) nodes[head->second].userPrev = slot;
+        head->second = slot;
+
+        if (static_cast<size_t>(node.hold.holdId) > holdSlots.size()) holdSlots.resize(node.hold.holdId, NIL);
+        holdSlots[node.hold.holdId - 1] = slot;
+        ++active;
+    }
+
+    void unlink(int slot) {
+        Node& node = nodes[slot];
+        auto queue = queues.find(node.hold.bookId);
+        if (node.prev != NIL) nodes[node.prev].next = node.next; else queue->second.head = node.next;
+        if (node.next != NIL) nodes[node.next].prev = node.prev; else queue->second.tail = node.prev;
+        if (--queue->second.length == 0) queues.erase(queue);
+
+        if (node.userPrev != NIL) {
+            nodes[node.userPrev].userNext = node.userNext;
+        } else if (node.userNext != NIL) {
+            userHeads[node.hold.userId] = node.userNext;
+        } else {
+            userHeads.erase(node.hold.userId);
+        }
+        if (node.userNext != NIL) nodes[node.userNext].userPrev = node.userPrev;
+
+        holdSlots[node.hold.holdId - 1] = ENDED;
+        node.next = freeList;
+        freeList = slot;
+        --active;
+    }
+
+    int slotOf(int holdId) const {
+        if (holdId <= 0 || static_cast<size_t>(holdId) > holdSlots.size()) return NIL;
+        return holdSlots[holdId - 1];
+    }
+
+public:
+    // Queue a new hold at the back of the book's line and return its ID
+    int place(int bookId, int userId, int64_t placedAt) {
+        std::lock_guard<std::mutex> lock(mtx);
+        int slot = allocate();
+        nodes[slot].hold = Hold{static_cast<int>(holdSlots.size() + 1), bookId, userId, placedAt};
+        link(slot);
+        return nodes[slot].hold.holdId;
+    }
+
+    // Queue a hold with its ID, as read back from holds.txt or the journal.
+    // A hold already queued or already ended is left alone.
+    bool insert(const Hold& hold) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (hold.holdId <= 0 || static_cast<size_t>(hold.holdId) > holdSlots.size() + MAX_ID_GAP) return false;
+        if (slotOf(hold.holdId) != NIL) return true;
+        int slot = allocate();
+        nodes[slot].hold = hold;
+        link(slot);
+        return true;
+    }
+
+    // Put back a hold whose cancellation or filling is being rolled back, at
+    // its place in line (IDs are handed out in placing order)
+    void restore(const Hold& hold) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (slotOf(hold.holdId) != ENDED) return;
+        int slot = allocate();
+        nodes[slot].hold = hold;
+        auto queue = queues.find(hold.bookId);
+        int before = queue == queues.end() ? NIL : queue->second.head;
+        while (before != NIL && nodes[before].hold.holdId < hold.holdId) before = nodes[before].next;
+        link(slot, before);
+    }
+
+    // Remove a hold, whether cancelled or filled; false if it is not queued
+    bool end(int holdId, Hold* ended = nullptr) {
+        std::lock_guard<std::mutex> lock(mtx);
+        int slot = slotOf(holdId);
+        if (slot < 0) return false;
+        if (ended) *ended = nodes[slot].hold;
+        unlink(slot);
+        return true;
+    }
+
+    // A queued hold by ID
+    bool find(int holdId, Hold& hold) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        int slot = slotOf(holdId);
+        if (slot < 0) return false;
+        hold = nodes[slot].hold;
+        return true;
+    }
+
+    // The first hold in a book's line, if any
+    bool front(int bookId, Hold& hold) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = queues.find(bookId);
+        if (it == queues.end()) return false;
+        hold = nodes[it->second.head].hold;
+        return true;
+    }
+
+    size_t queueLength(int bookId) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = queues.find(bookId);
+        return it == queues.end() ? 0 : it->second.length;
+    }
+
+    // The user's hold on a book (0 if none), and how many holds the user has
+    int holdOf(int userId, int bookId, size_t& userHolds) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        userHolds = 0;
+        int found = 0;
+        auto head = userHeads.find(userId);
+        for (int slot = head == userHeads.end() ? NIL : head->second; slot != NIL; slot = nodes[slot].userNext) {
+            ++userHolds;
+            if (nodes[slot].hold.bookId == bookId) found = nodes[slot].hold.holdId;
+        }
+        return found;
+    }
+
+    // Holds on a book in line order
+    std::vector<Hold> queueFor(int bookId) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<Hold> line;
+        auto it = queues.find(bookId);
+        if (it == queues.end()) return line;
+        line.reserve(it->second.length);
+        for (int slot = it->second.head; slot != NIL; slot = nodes[slot].next) line.push_back(nodes[slot].hold);
+        return line;
+    }
+
+    // IDs of the books that have a line, in no particular order
+    std::vector<int> booksWithHolds() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<int> ids;
+        ids.reserve(queues.size());
+        for (const auto& entry : queues) ids.push_back(entry.first);
+        return ids;
+    }
+
+    // Append every queued hold in holds.txt format, books by ID and each
+    // book's line in order, so the file is the same whatever the hash order
+    void serialize(std::string& out) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<std::pair<int, int>> heads;
+        heads.reserve(queues.size());
+        for (const auto& entry : queues) heads.emplace_back(entry.first, entry.second.head);
+        std::sort(heads.begin(), heads.end());
+        for (const auto& entry : heads) {
+            for (int slot = entry.second; slot != NIL; slot = nodes[slot].next) {
+                nodes[slot].hold.appendFileString(out);
+                out += '\n';
+            }
+        }
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return active;
+    }
+
+    size_t bookCount() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return queues.size();
+    }
+
+    size_t memoryUsage() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        const size_t entry = 2 * sizeof(void*);
+        return nodes.capacity() * sizeof(Node) + holdSlots.capacity() * sizeof(int) +
+               queues.size() * (sizeof(std::pair<const int, Queue>) + entry) +
+               userHeads.size() * (sizeof(std::pair<const int, int>) + entry);
+    }
+};
+
+// Error messages reported by library operations
+const char* const ERR_BOOK_NOT_FOUND = "Book not found!";
+const char* const ERR_USER_NOT_FOUND = "User not found!";
+const char* const ERR_ALREADY_ISSUED = "Book is already issued!";
+const char* const ERR_NOT_ISSUED = "Book is not currently issued!";
+const char* const ERR_DELETE_ISSUED = "Cannot delete an issued book!";
+const char* const ERR_JOURNAL = "Could not write to journal!";
+const char* const ERR_INVALID_CREDENTIALS = "Invalid credentials!";
+const char* const ERR_USERNAME_TAKEN = "Username already exists!";
+const char* const ERR_DUPLICATE_ISBN = "A book with this ISBN already exists!";
+const char* const ERR_HOLD_NOT_FOUND = "Hold not found!";
+const char* const ERR_ALREADY_HOLDING = "User already has a hold on this book!";
+const char* const ERR_HOLD_OWN_LOAN = "Book is already issued to this user!";
+const char* const ERR_HOLD_LIMIT = "Hold limit reached!";
+const char* const ERR_INVALID_FIELD = "Text fields cannot contain commas or control characters!";
+const char* const ERR_DUPLICATE_ID = "A book with this ID already exists!";
+
+// Outcome of a library operation, for callers that handle their own output.
+// Errors are static strings so reporting a failure never allocates.
+struct OpResult {
+    bool ok;
+    const char* error;
+    int id;
+
+    static OpResult success(int id) { return OpResult{true, nullptr, id}; }
+    static OpResult failure(const char* error, int id) { return OpResult{false, error, id}; }
+};
+
+// One ranked search hit. Title and author are views of interned strings, which
+// live for the whole process, so hits stay valid after the catalog changes.
+struct RankedHit {
+    int bookId;
+    int score;
+    std::string_view title;
+    std::string_view author;
+
+    // Higher scores first, ties broken by ascending book ID
+    bool ranksBefore(const RankedHit& other) const {
+        return score != other.score ? score > other.score : bookId < other.bookId;
+    }
+};
+
+// Position after the last hit of a page; the default cursor starts at the top.
+// Serialised as "<score>.<bookId>" for callers that hand it back later.
+struct SearchCursor {
+    int score = std::numeric_limits<int>::max();
+    int bookId = 0;
+
+    bool precedes(const RankedHit& hit) const {
+        return hit.score < score || (hit.score == score && hit.bookId > bookId);
+    }
+
+    std::string toString() const { return std::to_string(score) + "." + std::to_string(bookId); }
+
+    static bool parse(std::string_view text, SearchCursor& cursor) {
+        size_t dot = text.find('.');
+        if (dot == std::string_view::npos) return false;
+        const char* end = text.data() + text.size();
+        auto scoreResult = std::from_chars(text.data(), text.data() + dot, cursor.score);
+        auto idResult = std::from_chars(text.data() + dot + 1, end, cursor.bookId);
+        return scoreResult.ec == std::errc() && scoreResult.ptr == text.data() + dot &&
+               idResult.ec == std::errc() && idResult.ptr == end;
+    }
+};
+
+// One page of ranked hits, best first
+struct RankedPage {
+    std::vector<RankedHit> hits;
+    bool hasMore = false;
+    SearchCursor next;
+};
+
+// One fuzzy search hit: the closer of the title and author distances
+struct FuzzyHit {
+    int bookId;
+    int distance;
+    std::string_view title;
+    std::string_view author;
+
+    bool ranksBefore(const FuzzyHit& other) const {
+        return distance != other.distance ? distance < other.distance : bookId < other.bookId;
+    }
+};
+
+// Operations tracked by LibrarySystem statistics, in report order
+enum Operation { OP_ADD_BOOK, OP_UPDATE_BOOK, OP_DELETE_BOOK, OP_ISSUE_BOOK, OP_RETURN_BOOK, OP_ADD_USER,
+                 OP_SEARCH_BOOKS, OP_AUTOCOMPLETE, OP_VIEW_BOOKS, OP_VIEW_USERS, OP_ADMIN_LOGIN, OP_SAVE_DATA, OP_LOAD_DATA,
+                 OP_FLUSH, OP_OVERDUE_LOANS, OP_PLACE_HOLD, OP_CANCEL_HOLD, OP_TRANSACTION, OPERATION_COUNT };
+const char* const OPERATION_NAMES[OPERATION_COUNT] = {
+    "add_book", "update_book", "delete_book", "issue_book", "return_book", "add_user",
+    "search_books", "autocomplete", "view_books", "view_users", "admin_login", "save_data", "load_data",
+    "flush", "overdue_loans", "place_hold", "cancel_hold", "transaction"};
+
+// Errors counted separately per operation; anything else is "other"
+const char* const COUNTED_ERRORS[] = {ERR_BOOK_NOT_FOUND, ERR_USER_NOT_FOUND, ERR_ALREADY_ISSUED, ERR_NOT_ISSUED,
+                                      ERR_DELETE_ISSUED, ERR_JOURNAL, ERR_INVALID_CREDENTIALS,
+                                      ERR_USERNAME_TAKEN, ERR_DUPLICATE_ISBN, ERR_HOLD_NOT_FOUND, ERR_ALREADY_HOLDING,
+                                      ERR_HOLD_OWN_LOAN, ERR_HOLD_LIMIT, ERR_INVALID_FIELD, ERR_DUPLICATE_ID};
+const size_t ERROR_KIND_COUNT = std::size(COUNTED_ERRORS) + 1;
+
+// Lock-free counters and latency histogram for one operation. Buckets are
+// log2-spaced with four linear steps per power of two (at most ~25% error);
+// recording a sample is a handful of relaxed atomic increments.
+class alignas(64) OperationStats {
+private:
+    static constexpr size_t BUCKET_COUNT = 252;
+
+    std::atomic<uint64_t> buckets[BUCKET_COUNT];
+    std::atomic<uint64_t> errors[ERROR_KIND_COUNT];
+    std::atomic<uint64_t> samples;
+    std::atomic<uint64_t> maxNs;
+
+    static size_t bucketFor(uint64_t ns) {
+        if (ns < 4) return static_cast<size_t>(ns);
+        unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(ns));
+        return (msb - 1) * 4 + ((ns >> (msb - 2)) & 3);
+    }
+
+    // Smallest latency that falls into a bucket
+    static uint64_t bucketFloor(size_t bucket) {
+        if (bucket < 4) return bucket;
+        unsigned msb = static_cast<unsigned>(bucket / 4 + 1);
+        return (4 + bucket % 4) << (msb - 2);
+    }
+
+public:
+    OperationStats() { reset(); }
+
+    void reset() {
+        for (auto& bucket : buckets) bucket.store(0, std::memory_order_relaxed);
+        for (auto& error : errors) error.store(0, std::memory_order_relaxed);
+        samples.store(0, std::memory_order_relaxed);
+        maxNs.store(0, std::memory_order_relaxed);
+    }
+
+    void record(uint64_t ns, const char* error) {
+        buckets[bucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+        samples.fetch_add(1, std::memory_order_relaxed);
+        uint64_t seen = maxNs.load(std::memory_order_relaxed);
+        while (ns > seen && !maxNs.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {
+        }
+        if (!error) return;
+        size_t kind = 0;
+        while (kind < ERROR_KIND_COUNT - 1 && COUNTED_ERRORS[kind] != error) ++kind;
+        errors[kind].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return samples.load(std::memory_order_relaxed); }
+    uint64_t maxLatency() const { return maxNs.load(std::memory_order_relaxed); }
+    uint64_t errorCount(size_t kind) const { return errors[kind].load(std::memory_order_relaxed); }
+
+    uint64_t errorCount() const {
+        uint64_t total = 0;
+        for (const auto& error : errors) total += error.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    // Upper bound of the bucket holding the p-th fraction of samples, capped at the max
+    uint64_t percentile(double p) const {
+        uint64_t total = count();
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(total - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                uint64_t upper = i + 1 < BUCKET_COUNT ? bucketFloor(i + 1) - 1 : UINT64_MAX;
+                return std::min(upper, maxLatency());
+            }
+        }
+        return maxLatency();
+    }
+};
+
+// Records one sample into an OperationStats when it goes out of scope
+class OperationTimer {
+private:
+    OperationStats& stats;
+    std::chrono::steady_clock::time_point started;
+    const char* error;
+
+public:
+    explicit OperationTimer(OperationStats& target)
+        : stats(target), started(std::chrono::steady_clock::now()), error(nullptr) {}
+
+    ~OperationTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - started;
+        stats.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+                     error);
+    }
+
+    void fail(const char* message) { error = message; }
+};
+
+// Human-readable latency: ns, us or ms with one decimal
+inline std::string formatLatency(uint64_t ns) {
+    char text[32];
+    if (ns < 1000) {
+        std::snprintf(text, sizeof(text), "%lluns", static_cast<unsigned long long>(ns));
+    } else if (ns < 1000000) {
+        std::snprintf(text, sizeof(text), "%.1fus", ns / 1e3);
+    } else {
+        std::snprintf(text, sizeof(text), "%.1fms", ns / 1e6);
+    }
+    return text;
+}
+
+// Text commands understood by batch mode and the server, in summary order
+enum CommandType { CMD_ADD_BOOK, CMD_UPDATE_BOOK, CMD_DELETE_BOOK, CMD_ISSUE, CMD_RETURN,
+                   CMD_ADD_USER, CMD_ADD_ADMIN, CMD_HOLD, CMD_CANCEL_HOLD, CMD_BEGIN, CMD_COMMIT, CMD_ABORT,
+                   CMD_UNKNOWN, COMMAND_COUNT };
+const char* const COMMAND_NAMES[COMMAND_COUNT] = {
+    "ADD_BOOK", "UPDATE_BOOK", "DELETE_BOOK", "ISSUE", "RETURN", "ADD_USER", "ADD_ADMIN", "HOLD", "CANCEL_HOLD",
+    "BEGIN", "COMMIT", "ABORT", "UNKNOWN"};
+
+inline CommandType parseCommand(std::string_view word) {
+    for (size_t i = 0; i < CMD_UNKNOWN; ++i) {
+        if (word == COMMAND_NAMES[i]) return static_cast<CommandType>(i);
+    }
+    return CMD_UNKNOWN;
+}
+
+// Operations applied together by LibrarySystem::commitTransaction: all of
+// them take effect, as one journal record, or none do
+class Transaction {
+public:
+    struct Op {
+        CommandType command;  // CMD_ISSUE, CMD_RETURN, CMD_ADD_BOOK or CMD_ADD_USER
+        int bookId;
+        int userId;
+        std::string fields[3];  // title, author, isbn or name, email
+    };
+
+    Transaction& issue(int bookId, int userId) {
+        operations.push_back(Op{CMD_ISSUE, bookId, userId, {}});
+        return *this;
+    }
+
+    Transaction& returnBook(int bookId) {
+        operations.push_back(Op{CMD_RETURN, bookId, 0, {}});
+        return *this;
+    }
+
+    Transaction& addBook(const std::string& title, const std::string& author, const std::string& isbn) {
+        operations.push_back(Op{CMD_ADD_BOOK, 0, 0, {title, author, isbn}});
+        return *this;
+    }
+
+    Transaction& addUser(const std::string& name, const std::string& email) {
+        operations.push_back(Op{CMD_ADD_USER, 0, 0, {name, email, std::string()}});
+        return *this;
+    }
+
+    // Queue a batch-mode command line; returns an error for a malformed line
+    // or a command that cannot be part of a transaction
+    const char* add(CommandType command, std::string_view rest) {
+        std::string_view args[3];
+        int first = 0, second = 0;
+        switch (command) {
+            case CMD_ISSUE:
+                if (splitFields(rest, ' ', args, 2) != 2 || !parseInt(args[0], first) || !parseInt(args[1], second)) {
+                    return "expected book id and user id";
+                }
+                issue(first, second);
+                return nullptr;
+            case CMD_RETURN:
+                if (!parseInt(rest, first)) return "expected book id";
+                returnBook(first);
+                return nullptr;
+            case CMD_ADD_BOOK:
+                if (splitFields(rest, '|', args, 3) != 3) return "expected title|author|isbn";
+                if (!isStorableField(args[0]) || !isStorableField(args[1]) || !isStorableField(args[2])) {
+                    return ERR_INVALID_FIELD;
+                }
+                addBook(std::string(args[0]), std::string(args[1]), std::string(args[2]));
+                return nullptr;
+            case CMD_ADD_USER:
+                if (splitFields(rest, '|', args, 2) != 2) return "expected name|email";
+                if (!isStorableField(args[0]) || !isStorableField(args[1])) return ERR_INVALID_FIELD;
+                addUser(std::string(args[0]), std::string(args[1]));
+                return nullptr;
+            default:
+                return "not allowed in a transaction";
+        }
+    }
+
+    const std::vector<Op>& ops() const { return operations; }
+    size_t size() const { return operations.size(); }
+    bool empty() const { return operations.empty(); }
+    void clear() { operations.clear(); }
+
+private:
+    std::vector<Op> operations;
+};
+
+// Outcome of a transaction: the ID each operation touched or created, or the
+// index of the first operation that would have failed and why
+struct TransactionResult {
+    bool ok = true;
+    const char* error = nullptr;
+    size_t failedOp = 0;
+    std::vector<int> ids;
+
+    static TransactionResult failure(const char* error, size_t failedOp) {
+        TransactionResult result;
+        result.ok = false;
+        result.error = error;
+        result.failedOp = failedOp;
+        return result;
+    }
+};
+
+// Fixed-size pool of worker threads executing submitted tasks in FIFO order
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mtx;
+    std::condition_variable taskReady;
+    bool stopping;
+
+    void workerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                taskReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+public:
+    explicit ThreadPool(size_t threadCount) : stopping(false) {
+        if (threadCount == 0) threadCount = 1;
+        workers.reserve(threadCount);
+        for (size_t i = 0; i < threadCount; ++i) {
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Drains queued tasks before joining
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        taskReady.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    size_t size() const { return workers.size(); }
+
+    // Queue a callable and get a future for its result
+    template <typename F>
+    auto submit(F&& fn) -> std::future<decltype(fn())> {
+        typedef decltype(fn()) Result;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(fn));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            tasks.emplace_back([task]() { (*task)(); });
+        }
+        taskReady.notify_one();
+        return result;
+    }
+};
+
+// Library Management System class
+//
+// Thread safety: catalogMutex guards the shape of the catalog (the book store,
+// the users table, the ID maps and the search indices). Operations that add or
+// remove entries, or change indexed fields, take it exclusively; everything
+// else takes it shared. Per-entry state that changes under a shared lock
+// (a book's issue status, a user's issued-books list) is guarded by striped
+// mutexes keyed by book ID and user ID, always acquired book stripe first.
+// Listings, searches and exports read a pinned catalogVersions snapshot of
+// the book table instead, so long scans hold no lock that writers wait for.
+class LibrarySystem {
+private:
+    BookStore books;
+    // Copy-on-write versions of `books`; every change to it goes through a WriteScope
+    CatalogVersions catalogVersions;
+    // Users are built in userPool and listed here in ID-assignment order
+    UserPool userPool;
+    std::vector<User*> users;
+    std::unordered_map<int, int> bookIdToIndex;
+    // Issue and return history, with open loans indexed by due date
+    LoanLedger ledger;
+    // Patrons waiting for books on loan; a returned book goes to the first in line
+    HoldQueues holds;
+    // Books by normalized ISBN, for exact lookups and duplicate checks
+    IsbnIndex isbnKeys;
+    UserIndex userIdToIndex;
+    // Admins by username, so login never scans the user table
+    std::unordered_map<std::string, Admin*> adminsByUsername;
+    int nextBookId;
+    int nextUserId;
+    Admin* currentAdmin;  // guarded by catalogMutex
+    // Loaded admins whose username was taken already: (admin, earlier admin, username).
+    // Collected by applyPutUser, which may run on a load task, and printed after loading
+    struct ShadowedAdmin {
+        int userId;
+        int firstUserId;
+        std::string username;
+    };
+    std::vector<ShadowedAdmin> shadowedAdmins;
+
+    // Substring search indices, one per searchable field
+    TrigramIndex titleIndex;
+    TrigramIndex authorIndex;
+    TrigramIndex isbnIndex;
+    PrefixIndex titleCompletions;
+    PrefixIndex authorCompletions;
+
+    // File names
+    const std::string BOOKS_FILE = "books.txt";
+    const std::string USERS_FILE = "users.txt";
+    // Loan ledger; written alongside either snapshot format
+    const std::string LOANS_FILE = "loans.txt";
+    const std::string HOLDS_FILE = "holds.txt";
+    // Binary snapshot; when present it replaces books.txt/users.txt as the snapshot
+    const std::string SNAPSHOT_FILE = "library.snap";
+    const std::string JOURNAL_FILE = "library.journal";
+    // Journal segment being folded into a snapshot by a running checkpoint
+    const std::string CHECKPOINT_JOURNAL_FILE = "library.journal.old";
+
+    // Lock striping for concurrent access, see the class comment
+    static const size_t LOCK_STRIPES = 256;
+    struct alignas(64) LockStripe {
+        std::mutex mtx;
+    };
+    mutable std::shared_mutex catalogMutex;
+    mutable LockStripe bookStripes[LOCK_STRIPES];
+    mutable LockStripe userStripes[LOCK_STRIPES];
+
+    std::mutex& bookLock(int bookId) const {
+        return bookStripes[static_cast<unsigned>(bookId) % LOCK_STRIPES].mtx;
+    }
+
+    std::mutex& userLock(int userId) const {
+        return userStripes[static_cast<unsigned>(userId) % LOCK_STRIPES].mtx;
+    }
+
+    typedef std::unique_lock<std::shared_mutex> ExclusiveLock;
+    typedef std::shared_lock<std::shared_mutex> SharedLock;
+
+    // Optional worker pool for submitted operations
+    std::unique_ptr<ThreadPool> workers;
+
+    // Whether this instance loads from and saves to the data files
+    bool persistent;
+    // Threads used to parse and index the text data files; 0 means one per hardware thread
+    size_t loadThreads;
+
+    // Write-ahead journal of mutations since the last snapshot
+    Journal journal;
+    // Set when the journal ends in a torn record that could not be cut off;
+    // appending after it would put new records out of replay's reach
+    bool journalDamaged;
+
+    // One step that takes back part of an applied change
+    struct UndoStep {
+        enum Kind { PUT_BOOK, DELETE_BOOK, UNISSUE, REISSUE, END_HOLD, RESTORE_HOLD, REMOVE_USER };
+        Kind kind;
+        int id;         // book, hold or user ID
+        int userId;     // borrower, for UNISSUE and REISSUE
+        int loanId;     // for UNISSUE and REISSUE
+        Book book;      // previous state, for PUT_BOOK
+        Hold hold;      // for RESTORE_HOLD
+
+        static UndoStep make(Kind kind, int id, int userId = 0, int loanId = 0) {
+            UndoStep step;
+            step.kind = kind;
+            step.id = id;
+            step.userId = userId;
+            step.loanId = loanId;
+            return step;
+        }
+        static UndoStep putBook(const Book& book) {
+            UndoStep step = make(PUT_BOOK, book.getBookId());
+            step.book = book;
+            return step;
+        }
+        static UndoStep deleteBook(int bookId) { return make(DELETE_BOOK, bookId); }
+        static UndoStep unissue(int bookId, int userId, int loanId) { return make(UNISSUE, bookId, userId, loanId); }
+        static UndoStep reissue(int bookId, int userId, int loanId) { return make(REISSUE, bookId, userId, loanId); }
+        static UndoStep endHold(int holdId) { return make(END_HOLD, holdId); }
+        static UndoStep restoreHold(const Hold& hold) {
+            UndoStep step = make(RESTORE_HOLD, hold.holdId);
+            step.hold = hold;
+            return step;
+        }
+        static UndoStep removeUser(int userId) { return make(REMOVE_USER, userId); }
+    };
+    // Undo steps of journaled changes by LSN, kept until their record is durable
+    std::mutex undoMutex;
+    std::map<uint64_t, std::vector<UndoStep>> undoLog;
+    // Wait for each mutation's journal record to be fsynced before acknowledging it
+    std::atomic<bool> syncCommit;
+    // Fold the journal into a fresh snapshot once it grows past this many bytes
+    size_t checkpointThreshold;
+    // Set when a background checkpoint could not write the snapshot; the
+    // rotated segment is then kept and further checkpoints wait for exit
+    std::atomic<bool> checkpointFailed;
+
+    // Background flusher: checkpoints every flushInterval, and as soon as the
+    // journal passes checkpointThreshold, rewriting only the tables that changed
+    std::thread flushThread;
+    std::mutex flushMutex;  // guards flushInterval and flushStopping
+    std::condition_variable flushWake;
+    std::chrono::milliseconds flushInterval;  // zero: only on journal size
+    bool flushStopping;
+    std::atomic<bool> flushRequested;
+    // Held for a whole snapshot write, so the files never go back to an older state
+    std::mutex snapshotWriteMutex;
+    // Change counters bumped by every apply*, and their values as of the last
+    // snapshot written (guarded by snapshotWriteMutex)
+    std::atomic<uint64_t> booksVersion;
+    std::atomic<uint64_t> usersVersion;
+    std::atomic<uint64_t> loansVersion;
+    std::atomic<uint64_t> holdsVersion;
+    uint64_t booksSavedVersion;
+    uint64_t usersSavedVersion;
+    uint64_t loansSavedVersion;
+    uint64_t holdsSavedVersion;
+    // Table copies and serialization buffers kept between flushes (flush thread only)
+    std::vector<Loan> flushLoans;
+    std::string bookBuffer;
+    std::string userBuffer;
+    std::string loanBuffer;
+    std::string holdBuffer;
+    std::atomic<uint64_t> flushCount;
+    std::atomic<uint64_t> lastFlushNs;
+    std::atomic<uint64_t> lastFlushLockedNs;  // part of lastFlushNs spent holding the catalog
+    std::atomic<uint64_t> lastFlushBytes;
+    // Snapshot format in use, chosen at load time
+    bool binarySnapshot;
+
+    // Per-operation counters and latency histograms; recording is lock-free
+    mutable OperationStats stats[OPERATION_COUNT];
+
+    // Malformed lines reported individually before switching to a count
+    static const size_t MAX_REPORTED_MALFORMED = 20;
+
+    static constexpr std::chrono::milliseconds DEFAULT_FLUSH_INTERVAL{5000};
+    // How long a book may be kept
+    static constexpr int64_t LOAN_PERIOD_SECONDS = 14 * 24 * 60 * 60;
+    // Books one patron may be waiting for at a time
+    static constexpr size_t MAX_HOLDS_PER_USER = 20;
+
+    static int64_t currentTime() { return static_cast<int64_t>(std::time(nullptr)); }
+
+    // Run a core operation, recording its latency and outcome
+    template <typename Fn>
+    OpResult timed(Operation op, Fn fn) {
+        OperationTimer timer(stats[op]);
+        OpResult result = fn();
+        if (!result.ok) timer.fail(result.error);
+        return result;
+    }
+
+    // Add a book's fields to the search indices
+    void indexBook(const Book& book) {
+        titleIndex.insert(book.getBookId(), book.getTitle());
+        authorIndex.insert(book.getBookId(), book.getAuthor());
+        isbnIndex.insert(book.getBookId(), book.getIsbn());
+        titleCompletions.insert(book.getTitleHandle());
+        authorCompletions.insert(book.getAuthorHandle());
+        if (uint64_t key = isbnKey(book.getIsbn())) isbnKeys.insert(key, book.getBookId());
+    }
+
+    // Remove a book's fields from the search indices
+    void unindexBook(const Book& book) {
+        titleIndex.remove(book.getBookId(), book.getTitle());
+        authorIndex.remove(book.getBookId(), book.getAuthor());
+        isbnIndex.remove(book.getBookId(), book.getIsbn());
+        titleCompletions.remove(book.getTitleHandle());
+        authorCompletions.remove(book.getAuthorHandle());
+        if (uint64_t key = isbnKey(book.getIsbn())) isbnKeys.erase(key, book.getBookId());
+    }
+
+    // ID of a book other than `exceptBookId` with the same ISBN, or -1.
+    // Text that is not a valid ISBN never counts as a duplicate.
+    int bookWithIsbn(std::string_view isbn, int exceptBookId) const {
+        uint64_t key = isbnKey(isbn);
+        return key == 0 ? -1 : isbnKeys.findOther(key, exceptBookId);
+    }
+
+    // Loaders add many books at once; completions are sorted once at the end
+    void beginBulkIndexing() {
+        titleCompletions.beginBulkLoad();
+        authorCompletions.beginBulkLoad();
+    }
+
+    void endBulkIndexing() {
+        titleCompletions.endBulkLoad();
+        authorCompletions.endBulkLoad();
+    }
+
+    // Index for a search type, or nullptr if the type is unknown
+    const TrigramIndex* indexFor(const std::string& searchType) const {
+        if (searchType == "title") return &titleIndex;
+        if (searchType == "author") return &authorIndex;
+        if (searchType == "isbn") return &isbnIndex;
+        return nullptr;
+    }
+
+    // Squeeze holes out of the book store and remap slot indices
+    void compactBooks() {
+        books.compact();
+        bookIdToIndex.clear();
+        for (auto it = books.begin(); it != books.end(); ++it) {
+            bookIdToIndex[books.bookId(it.index())] = it.index();
+        }
+        CatalogVersions::WriteScope versions(catalogVersions);
+        versions.assign(books);
+    }
+
+    // Insert or replace a book, keeping indices in sync
+    void applyPutBook(const Book& book) {
+        CatalogVersions::WriteScope versions(catalogVersions);
+        auto it = bookIdToIndex.find(book.getBookId());
+        if (it != bookIdToIndex.end()) {
+            unindexBook(books[it->second]);
+            books.set(it->second, book);
+            versions.put(it->second, book);
+        } else {
+            size_t slot = books.insert(book);
+            bookIdToIndex[book.getBookId()] = slot;
+            versions.put(slot, book);
+        }
+        indexBook(book);
+        if (book.getBookId() >= nextBookId) nextBookId = book.getBookId() + 1;
+        booksVersion.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Remove a book if present
+    void applyDeleteBook(int bookId) {
+        auto it = bookIdToIndex.find(bookId);
+        if (it == bookIdToIndex.end()) return;
+        CatalogVersions::WriteScope versions(catalogVersions);
+        unindexBook(books[it->second]);
+        books.erase(it->second);
+        versions.erase(it->second);
+        bookIdToIndex.erase(it);
+        if (books.needsCompaction()) {
+            compactBooks();
+        }
+        booksVersion.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Mark a book as issued to a user
+    void applyIssue(int bookId, int userId) {
+        auto bookIt = bookIdToIndex.find(bookId);
+        if (bookIt == bookIdToIndex.end()) return;
+        CatalogVersions::WriteScope versions(catalogVersions);
+        books.setIssued(bookIt->second, true, userId);
+        versions.setIssued(bookIt->second, true, userId);
+        booksVersion.fetch_add(1, std::memory_order_relaxed);
+        int userIndex = userIdToIndex.find(userId);
+        if (userIndex >= 0) {
+            User* user = users[userIndex];
+            user->removeIssuedBook(bookId);
+            user->addIssuedBook(bookId);
+            usersVersion.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Mark a book as returned by a user
+    void applyReturn(int bookId, int userId) {
+        auto bookIt = bookIdToIndex.find(bookId);
+        if (bookIt != bookIdToIndex.end()) {
+            CatalogVersions::WriteScope versions(catalogVersions);
+            books.setIssued(bookIt->second, false, -1);
+            versions.setIssued(bookIt->second, false, -1);
+            booksVersion.fetch_add(1, std::memory_order_relaxed);
+        }
+        int userIndex = userIdToIndex.find(userId);
+        if (userIndex >= 0) {
+            users[userIndex]->removeIssuedBook(bookId);
+            usersVersion.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Insert or replace a user, taking ownership of an object from userPool
+    void applyPutUser(User* user) {
+        int index = userIdToIndex.find(user->getUserId());
+        if (index >= 0) {
+            User* old = users[index];
+            if (old == currentAdmin) currentAdmin = nullptr;
+            if (Admin* oldAdmin = dynamic_cast<Admin*>(old)) {
+                auto entry = adminsByUsername.find(oldAdmin->getUsername());
+                if (entry != adminsByUsername.end() && entry->second == oldAdmin) adminsByUsername.erase(entry);
+            }
+            userPool.destroy(old);
+            users[index] = user;
+        } else {
+            users.push_back(user);
+            userIdToIndex.insert(user->getUserId(), static_cast<int>(users.size() - 1));
+        }
+        if (Admin* admin = dynamic_cast<Admin*>(user)) {
+            // The first admin keeps a username; a later one from the data files is
+            // loaded but cannot log in, rather than silently taking over the login
+            auto placed = adminsByUsername.emplace(admin->getUsername(), admin);
+            if (!placed.second && placed.first->second != admin) {
+                shadowedAdmins.push_back({admin->getUserId(), placed.first->second->getUserId(), admin->getUsername()});
+            }
+        }
+        if (user->getUserId() >= nextUserId) nextUserId = user->getUserId() + 1;
+        usersVersion.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Add a loan with its ID to the ledger if not already there
+    void applyLoan(const Loan& loan) {
+        if (ledger.insert(loan)) loansVersion.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Close a loan if it is still open
+    void applyLoanReturn(int loanId, int64_t returnedAt) {
+        ledger.close(loanId, returnedAt);
+        loansVersion.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Queue a hold with its ID if it is not already queued or ended
+    void applyHold(const Hold& hold) {
+        if (holds.insert(hold)) holdsVersion.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Drop a hold from its line, whether cancelled or filled
+    void applyEndHold(int holdId) {
+        if (holds.end(holdId)) holdsVersion.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Drop a user whose addition is being rolled back
+    void applyRemoveUser(int userId) {
+        int index = userIdToIndex.find(userId);
+        if (index < 0) return;
+        User* user = users[index];
+        if (user == currentAdmin) currentAdmin = nullptr;
+        if (Admin* admin = dynamic_cast<Admin*>(user)) {
+            auto entry = adminsByUsername.find(admin->getUsername());
+            if (entry != adminsByUsername.end() && entry->second == admin) adminsByUsername.erase(entry);
+        }
+        users.erase(users.begin() + index);
+        userIdToIndex.erase(userId);
+        for (size_t i = index; i < users.size(); ++i) {
+            userIdToIndex.insert(users[i]->getUserId(), static_cast<int>(i));
+        }
+        userPool.destroy(user);
+        usersVersion.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Keep an undo step for the change being journaled; with the journal off
+    // nothing can fail to reach it
+    void remember(std::vector<UndoStep>& undo, const UndoStep& step) const {
+        if (journal.isOpen()) undo.push_back(step);
+    }
+
+    // Take back one applied change; caller holds catalogMutex exclusively
+    void applyUndo(const UndoStep& step) {
+        switch (step.kind) {
+            case UndoStep::PUT_BOOK:
+                applyPutBook(step.book);
+                break;
+            case UndoStep::DELETE_BOOK:
+                applyDeleteBook(step.id);
+                break;
+            case UndoStep::UNISSUE:
+                applyReturn(step.id, step.userId);
+                ledger.discard(step.loanId);
+                loansVersion.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case UndoStep::REISSUE:
+                applyIssue(step.id, step.userId);
+                ledger.reopen(step.loanId);
+                loansVersion.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case UndoStep::END_HOLD:
+                applyEndHold(step.id);
+                break;
+            case UndoStep::RESTORE_HOLD:
+                holds.restore(step.hold);
+                holdsVersion.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case UndoStep::REMOVE_USER:
+                applyRemoveUser(step.id);
+                break;
+        }
+    }
+
+    // Issue a book and open its loan; caller holds the book's and user's
+    // stripes and has checked both exist. Returns the journal record.
+    std::string issueLocked(int bookId, int userId, std::vector<UndoStep>& undo) {
+        applyIssue(bookId, userId);
+        int64_t now = currentTime();
+        int loanId = ledger.open(bookId, userId, now, now + LOAN_PERIOD_SECONDS);
+        loansVersion.fetch_add(1, std::memory_order_relaxed);
+        remember(undo, UndoStep::unissue(bookId, userId, loanId));
+        return "ISSUE," + std::to_string(bookId) + "," + std::to_string(userId) + "," + std::to_string(loanId) +
+               "," + std::to_string(now) + "," + std::to_string(now + LOAN_PERIOD_SECONDS);
+    }
+
+    // Return a book, close its loan and hand it to the first patron in line,
+    // appending the journal records; caller holds the book's stripe and those
+    // of the borrower and the first in line
+    void returnLocked(int bookId, int userId, std::vector<std::string>& records, std::vector<UndoStep>& undo) {
+        // Snapshots see the return and the handoff together
+        CatalogVersions::WriteScope versions(catalogVersions);
+        applyReturn(bookId, userId);
+        int64_t now = currentTime();
+        int loanId = ledger.closeOpenFor(bookId, now);
+        loansVersion.fetch_add(1, std::memory_order_relaxed);
+        remember(undo, UndoStep::reissue(bookId, userId, loanId));
+        records.push_back("RETURN," + std::to_string(bookId) + "," + std::to_string(userId) + "," +
+                          std::to_string(loanId) + "," + std::to_string(now));
+        Hold next;
+        if (holds.front(bookId, next)) {
+            applyEndHold(next.holdId);
+            remember(undo, UndoStep::restoreHold(next));
+            records.push_back("END_HOLD," + std::to_string(next.holdId));
+            records.push_back(issueLocked(bookId, next.userId, undo));
+        }
+    }
+
+    // Journal a mutation and return its LSN (0 when journaling is off).
+    // Must be called while holding the locks that guard the change, so records
+    // for the same book or user land in the journal in the order they applied.
+    // Every record is an idempotent upsert or assignment so that replaying a
+    // segment already folded into the snapshot is harmless. The steps that
+    // undo the change are kept until the record is durable.
+    uint64_t logRecord(const std::string& record, std::vector<UndoStep>& undo) {
+        if (!journal.isOpen()) return 0;
+        uint64_t lsn = journal.append(record);
+        std::lock_guard<std::mutex> lock(undoMutex);
+        undoLog[lsn].swap(undo);
+        return lsn;
+    }
+
+    // Drop the undo steps of changes that are durable now
+    void forgetUndo(uint64_t durableLsn) {
+        std::lock_guard<std::mutex> lock(undoMutex);
+        undoLog.erase(undoLog.begin(), undoLog.upper_bound(durableLsn));
+    }
+
+    // After a journal failure, take back every change whose record did not
+    // reach the disk, newest first, so memory matches what recovery will load
+    void rollBackUndurable() {
+        ExclusiveLock lock(catalogMutex);
+        CatalogVersions::WriteScope versions(catalogVersions);
+        std::lock_guard<std::mutex> undoLock(undoMutex);
+        auto first = undoLog.upper_bound(journal.durableThrough());
+        for (auto it = undoLog.end(); it != first;) {
+            --it;
+            for (auto step = it->second.rbegin(); step != it->second.rend(); ++step) applyUndo(*step);
+        }
+        undoLog.erase(first, undoLog.end());
+    }
+
+    // Journal several records as one, so replay applies all of them or none.
+    // Sub-records are length-prefixed (TXN,<length>:<record>,...), so no
+    // field content can be mistaken for the start of another record.
+    uint64_t logRecords(const std::vector<std::string>& records, std::vector<UndoStep>& undo) {
+        if (records.size() == 1) return logRecord(records.front(), undo);
+        std::string combined = "TXN";
+        for (const std::string& record : records) {
+            combined += ',';
+            appendInt(combined, record.size());
+            combined += ':';
+            combined += record;
+        }
+        return logRecord(combined, undo);
+    }
+
+    // Finish a journaled operation after its locks are released: wait for
+    // durability (sharing the fsync with concurrent committers) and start a
+    // checkpoint if the journal has grown large
+    OpResult finishCommit(uint64_t lsn, int id) {
+        if (lsn == 0) return OpResult::success(id);
+        bool ok = !syncCommit.load() || journal.waitDurable(lsn);
+        if (journal.hasFailed()) {
+            rollBackUndurable();
+            ok = journal.durableThrough() >= lsn;
+        } else {
+            forgetUndo(journal.durableThrough());
+        }
+        if (journal.sizeBytes() >= checkpointThreshold && !flushRequested.exchange(true)) {
+            std::lock_guard<std::mutex> lock(flushMutex);
+            flushWake.notify_one();
+        }
+        return ok ? OpResult::success(id) : OpResult::failure(ERR_JOURNAL, id);
+    }
+
+    // Apply one journal record during recovery
+    void replayRecord(std::string_view record) {
+        if (record.substr(0, 4) == "TXN,") {
+            // Check every length first: a malformed record is skipped whole
+            std::vector<std::string_view> parts;
+            for (size_t start = 4; start < record.size();) {
+                size_t colon = record.find(':', start);
+                size_t length = 0;
+                if (colon == std::string_view::npos || !parseInt(record.substr(start, colon - start), length) ||
+                    length > record.size() - colon - 1) {
+                    return;
+                }
+                parts.push_back(record.substr(colon + 1, length));
+                start = colon + 1 + length;
+                if (start < record.size() && record[start++] != ',') return;
+            }
+            for (std::string_view part : parts) replayRecord(part);
+            return;
+        }
+        if (record.substr(0, 4) == std::string_view("TXN\x1e", 4)) {
+            // Written before sub-records were length-prefixed
+            for (size_t start = 4; start <= record.size();) {
+                size_t end = std::min(record.find('\x1e', start), record.size());
+                replayRecord(record.substr(start, end - start));
+                start = end + 1;
+            }
+            return;
+        }
+        size_t comma = record.find(',');
+        std::string_view type = record.substr(0, comma);
+        std::string_view body = comma == std::string_view::npos ? std::string_view() : record.substr(comma + 1);
+
+        if (type == "BOOK") {
+            Book book;
+            if (book.fromFileString(body)) applyPutBook(book);
+        } else if (type == "USER") {
+            User* user = parseUserRow(body, userPool);
+            if (user && user->getUserId() != 0) {
+                applyPutUser(user);
+            } else {
+                userPool.destroy(user);
+            }
+        } else if (type == "HOLD") {
+            Hold hold;
+            if (hold.fromFileString(body)) applyHold(hold);
+        } else {
+            // ISSUE,book,user,loan,issuedAt,dueAt and RETURN,book,user,loan,returnedAt;
+            // records from before the ledger stop after the user
+            std::string_view args[5];
+            size_t count = splitFields(body, ',', args, 5);
+            int first = 0, second = 0;
+            if (count < 1 || !parseInt(args[0], first)) return;
+            if (type == "DELETE_BOOK") {
+                applyDeleteBook(first);
+            } else if (type == "END_HOLD") {
+                applyEndHold(first);
+            } else if (count >= 2 && parseInt(args[1], second)) {
+                Loan loan;
+                loan.bookId = first;
+                loan.userId = second;
+                if (type == "ISSUE") {
+                    applyIssue(first, second);
+                    if (count >= 5 && parseInt(args[2], loan.loanId) && parseInt(args[3], loan.issuedAt) &&
+                        parseInt(args[4], loan.dueAt)) {
+                        applyLoan(loan);
+                    }
+                } else if (type == "RETURN") {
+                    applyReturn(first, second);
+                    if (count >= 4 && parseInt(args[2], loan.loanId) && parseInt(args[3], loan.returnedAt)) {
+                        applyLoanReturn(loan.loanId, loan.returnedAt);
+                    }
+                }
+            }
+        }
+    }
+
+    // Serialize the current state into (path, contents) pairs in the active snapshot format
+    std::vector<std::pair<std::string, std::string>> serializeSnapshot() const {
+        std::vector<std::pair<std::string, std::string>> files;
+        if (binarySnapshot) {
+            files.emplace_back(SNAPSHOT_FILE, BinarySnapshot::encode(books, users));
+        } else {
+            files.emplace_back(BOOKS_FILE, std::string());
+            serializeBooks(books, files.back().second);
+            files.emplace_back(USERS_FILE, std::string());
+            serializeUsers(users, files.back().second);
+        }
+        std::vector<Loan> loanTable;
+        ledger.copyTo(loanTable);
+        files.emplace_back(LOANS_FILE, std::string());
+        LoanLedger::serialize(loanTable, files.back().second);
+        files.emplace_back(HOLDS_FILE, std::string());
+        holds.serialize(files.back().second);
+        return files;
+    }
+
+    // Write each snapshot file atomically
+    static bool writeSnapshotFiles(const std::vector<std::pair<std::string, std::string>>& files) {
+        bool ok = true;
+        for (const auto& file : files) {
+            ok = writeFileAtomically(file.first, file.second) && ok;
+        }
+        return ok;
+    }
+
+    // Serialize a book table in books.txt format, appending to `out`
+    static void serializeBooks(const BookStore& store, std::string& out) {
+        for (const auto& book : store) {
+            book.appendFileString(out);
+            out += '\n';
+        }
+    }
+
+    static void serializeBooks(const CatalogVersions::Snapshot& snapshot, std::string& out) {
+        snapshot.forEachLive([&](size_t slot) {
+            snapshot[slot].appendFileString(out);
+            out += '\n';
+        });
+    }
+
+    // Serialize a user table in users.txt format, appending to `out`
+    static void serializeUsers(const std::vector<User*>& table, std::string& out) {
+        for (const User* user : table) {
+            user->appendFileString(out);
+            out += '\n';
+        }
+    }
+
+    // Copy the user table into `pool`, so it can be serialized after unlocking
+    void copyUsers(UserPool& pool, std::vector<User*>& out) const {
+        out.reserve(users.size());
+        for (const User* user : users) {
+            const Admin* admin = dynamic_cast<const Admin*>(user);
+            out.push_back(admin ? static_cast<User*>(pool.create<Admin>(*admin)) : pool.create<User>(*user));
+        }
+    }
+
+    // Flush thread: checkpoint when the interval has passed or the journal asked for one
+    void flushLoop() {
+        auto lastStarted = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(flushMutex);
+        while (!flushStopping) {
+            std::chrono::milliseconds interval = flushInterval;
+            bool due = interval.count() > 0 && std::chrono::steady_clock::now() - lastStarted >= interval;
+            if (!due && !flushRequested.load()) {
+                // Woken early by a request, a new interval or shutdown; look again
+                if (interval.count() > 0) {
+                    flushWake.wait_until(lock, lastStarted + interval);
+                } else {
+                    flushWake.wait(lock);
+                }
+                continue;
+            }
+            flushRequested.store(false);
+            lastStarted = std::chrono::steady_clock::now();
+            lock.unlock();
+            flushChanges();
+            lock.lock();
+        }
+    }
+
+    // Checkpoint: rotate the journal and rewrite the snapshot files of the
+    // tables that changed since the last snapshot. The catalog is locked only
+    // to rotate, pin the current version of the book table and copy the users;
+    // both are serialized (or encoded) from those and files written after.
+    void flushChanges() {
+        if (checkpointFailed.load()) return;
+        std::lock_guard<std::mutex> writing(snapshotWriteMutex);
+        auto started = std::chrono::steady_clock::now();
+        uint64_t booksSeen, usersSeen, loansSeen, holdsSeen;
+        bool booksChanged, usersChanged, loansChanged, holdsChanged;
+        std::vector<std::pair<const std::string*, const std::string*>> files;
+        CatalogVersions::Snapshot flushBooks;
+        UserPool flushUserPool;
+        std::vector<User*> flushUsers;
+        {
+            ExclusiveLock lock(catalogMutex);
+            booksSeen = booksVersion.load();
+            usersSeen = usersVersion.load();
+            loansSeen = loansVersion.load();
+            holdsSeen = holdsVersion.load();
+            booksChanged = booksSeen != booksSavedVersion;
+            usersChanged = usersSeen != usersSavedVersion;
+            loansChanged = loansSeen != loansSavedVersion;
+            holdsChanged = holdsSeen != holdsSavedVersion;
+            if (!booksChanged && !usersChanged && !loansChanged && !holdsChanged) return;
+
+            if (journal.isOpen()) {
+                journal.close();
+                // Changes the journal could not write are rolled back, not saved
+                if (journal.hasFailed()) {
+                    journal.open(JOURNAL_FILE);
+                    checkpointFailed.store(true);
+                    return;
+                }
+                bool rotated = std::rename(JOURNAL_FILE.c_str(), CHECKPOINT_JOURNAL_FILE.c_str()) == 0;
+                journal.open(JOURNAL_FILE);
+                if (!rotated) return;
+            }
+
+            bookBuffer.clear();
+            userBuffer.clear();
+            loanBuffer.clear();
+            holdBuffer.clear();
+            // The binary snapshot holds both tables, so either change rewrites it
+            if (binarySnapshot) booksChanged = usersChanged = booksChanged || usersChanged;
+            if (booksChanged) {
+                flushBooks = catalogVersions.pin();
+                files.emplace_back(binarySnapshot ? &SNAPSHOT_FILE : &BOOKS_FILE, &bookBuffer);
+            }
+            if (usersChanged) {
+                copyUsers(flushUserPool, flushUsers);
+                if (!binarySnapshot) files.emplace_back(&USERS_FILE, &userBuffer);
+            }
+            if (loansChanged) {
+                ledger.copyTo(flushLoans);
+                files.emplace_back(&LOANS_FILE, &loanBuffer);
+            }
+            // Lines are short-lived and few next to the catalog, so they are written out here
+            if (holdsChanged) {
+                holds.serialize(holdBuffer);
+                files.emplace_back(&HOLDS_FILE, &holdBuffer);
+            }
+        }
+        auto unlocked = std::chrono::steady_clock::now();
+        if (binarySnapshot && booksChanged) {
+            bookBuffer = BinarySnapshot::encode(flushBooks, flushUsers);
+        } else {
+            if (booksChanged) serializeBooks(flushBooks, bookBuffer);
+            if (usersChanged) serializeUsers(flushUsers, userBuffer);
+        }
+        // Holding the pin would keep every later replaced leaf alive
+        flushBooks.release();
+        for (User* user : flushUsers) flushUserPool.destroy(user);
+        if (loansChanged) LoanLedger::serialize(flushLoans, loanBuffer);
+
+        bool ok = true;
+        size_t bytes = 0;
+        for (const auto& file : files) {
+            ok = writeFileAtomically(*file.first, *file.second) && ok;
+            bytes += file.second->size();
+        }
+        if (ok) {
+            std::remove(CHECKPOINT_JOURNAL_FILE.c_str());
+            booksSavedVersion = booksSeen;
+            usersSavedVersion = usersSeen;
+            loansSavedVersion = loansSeen;
+            holdsSavedVersion = holdsSeen;
+        } else {
+            checkpointFailed.store(true);
+        }
+        auto nanoseconds = [](std::chrono::steady_clock::duration d) {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+        };
+        uint64_t totalNs = nanoseconds(std::chrono::steady_clock::now() - started);
+        stats[OP_FLUSH].record(totalNs, ok ? nullptr : "could not write data files");
+        flushCount.fetch_add(1);
+        lastFlushBytes.store(bytes);
+        lastFlushLockedNs.store(nanoseconds(unlocked - started));
+        lastFlushNs.store(totalNs);
+    }
+
+    void stopFlushThread() {
+        {
+            std::lock_guard<std::mutex> lock(flushMutex);
+            flushStopping = true;
+        }
+        flushWake.notify_one();
+        if (flushThread.joinable()) flushThread.join();
+    }
+
+    // Check a transaction's operations in order against the tables plus the
+    // effects of the operations before them, without changing anything; books
+    // and users added earlier get the next IDs and may be used later on.
+    // Returns the index of the first that would fail and sets `error`.
+    // Caller holds catalogMutex exclusively.
+    size_t validateTransaction(const Transaction& txn, const char*& error) const {
+        std::unordered_map<int, int> borrowers;                // touched books: borrower, or -1
+        std::unordered_map<int, std::vector<Hold>> lines;      // lines of returned books
+        std::unordered_map<int, size_t> served;                // holds handed a book so far
+        std::vector<uint64_t> addedIsbns;
+        int addedBookId = nextBookId;
+        int addedUserId = nextUserId;
+        for (size_t i = 0; i < txn.size(); ++i) {
+            const Transaction::Op& op = txn.ops()[i];
+            if (op.command != CMD_ISSUE && op.command != CMD_RETURN && op.command != CMD_ADD_BOOK &&
+                op.command != CMD_ADD_USER) {
+                error = "not allowed in a transaction";
+                return i;
+            }
+            if ((op.command == CMD_ADD_BOOK || op.command == CMD_ADD_USER) &&
+                !(isStorableField(op.fields[0]) && isStorableField(op.fields[1]) && isStorableField(op.fields[2]))) {
+                error = ERR_INVALID_FIELD;
+                return i;
+            }
+            if (op.command == CMD_ADD_BOOK) {
+                uint64_t key = isbnKey(op.fields[2]);
+                if (key != 0 && (isbnKeys.findOther(key, -1) >= 0 ||
+                                 std::find(addedIsbns.begin(), addedIsbns.end(), key) != addedIsbns.end())) {
+                    error = ERR_DUPLICATE_ISBN;
+                    return i;
+                }
+                if (key != 0) addedIsbns.push_back(key);
+                borrowers[addedBookId++] = -1;
+                continue;
+            }
+            if (op.command == CMD_ADD_USER) {
+                ++addedUserId;
+                continue;
+            }
+
+            auto state = borrowers.find(op.bookId);
+            if (state == borrowers.end()) {
+                auto bookIt = bookIdToIndex.find(op.bookId);
+                if (bookIt == bookIdToIndex.end()) {
+                    error = ERR_BOOK_NOT_FOUND;
+                    return i;
+                }
+                state = borrowers.emplace(op.bookId, books.isIssued(bookIt->second)
+                                                         ? books.issuedToUserId(bookIt->second) : -1).first;
+            }
+            int& borrower = state->second;
+            if (op.command == CMD_ISSUE) {
+                bool addedUser = op.userId >= nextUserId && op.userId < addedUserId;
+                if (!addedUser && userIdToIndex.find(op.userId) < 0) error = ERR_USER_NOT_FOUND;
+                else if (borrower >= 0) error = ERR_ALREADY_ISSUED;
+                if (error) return i;
+                borrower = op.userId;
+            } else {
+                if (borrower < 0) {
+                    error = ERR_NOT_ISSUED;
+                    return i;
+                }
+                auto line = lines.find(op.bookId);
+                if (line == lines.end()) line = lines.emplace(op.bookId, holds.queueFor(op.bookId)).first;
+                size_t& next = served[op.bookId];
+                borrower = next < line->second.size() ? line->second[next++].userId : -1;
+            }
+        }
+        return txn.size();
+    }
+
+    // Add a new book; caller holds catalogMutex exclusively. Returns the journal record.
+    std::string addBookLocked(int id, const std::string& title, const std::string& author, const std::string& isbn,
+                              std::vector<UndoStep>& undo) {
+        auto existing = bookIdToIndex.find(id);
+        remember(undo, existing == bookIdToIndex.end() ? UndoStep::deleteBook(id)
+                                                      : UndoStep::putBook(books[existing->second]));
+        Book newBook(id, title, author, isbn);
+        applyPutBook(newBook);
+        return "BOOK," + newBook.toFileString();
+    }
+
+    // Copy the book in a slot with its issue status read under the book's stripe lock
+    Book snapshotBook(size_t slot) const {
+        std::lock_guard<std::mutex> guard(bookLock(books.bookId(slot)));
+        return books[slot];
+    }
+
+    // Slots of books whose field contains the query, in catalog order, in the
+    // version pinned into `snapshot`. The catalog lock is held shared only to
+    // probe the index and pin, so the slots match bookIdToIndex; candidates
+    // are verified, and short queries scanned, in the snapshot after unlocking.
+    // An ISBN search for a complete ISBN also returns the books whose ISBN is
+    // the same number written differently (hyphens, ISBN-10 or -13).
+    std::vector<size_t> matchingSlots(const std::string& query, const std::string& searchType, bool ignoreCase,
+                                      CatalogVersions::Snapshot& snapshot) const {
+        std::vector<size_t> matches;
+        std::vector<size_t> sameIsbn;
+        const TrigramIndex* index = indexFor(searchType);
+        bool scan = query.size() < TrigramIndex::MIN_QUERY_LENGTH;
+        {
+            SharedLock catalog(catalogMutex);
+            snapshot = catalogVersions.pin();
+            if (!index) return matches;
+            uint64_t key = index == &isbnIndex ? isbnKey(query) : 0;
+            if (key != 0) {
+                isbnKeys.forEach(key, [&](int bookId) {
+                    auto it = bookIdToIndex.find(bookId);
+                    if (it != bookIdToIndex.end()) sameIsbn.push_back(it->second);
+                });
+            }
+            if (!scan) {
+                for (int bookId : index->candidates(query)) {
+                    auto it = bookIdToIndex.find(bookId);
+                    if (it != bookIdToIndex.end()) matches.push_back(it->second);
+                }
+            }
+        }
+
+        const BookStore::Field field = fieldFor(searchType);
+        const std::string folded = ignoreCase ? CaseFoldSearch::fold(query) : std::string();
+        auto contains = [&](std::string_view text) {
+            return ignoreCase ? CaseFoldSearch::find(text, folded) != std::string_view::npos
+                              : text.find(query) != std::string_view::npos;
+        };
+
+        if (!scan) {
+            // Verify index candidates, then restore catalog order
+            auto mismatch = [&](size_t slot) { return !contains(snapshot.text(field, slot)); };
+            matches.erase(std::remove_if(matches.begin(), matches.end(), mismatch), matches.end());
+            std::sort(matches.begin(), matches.end());
+        } else {
+            // Queries too short for trigrams fall back to a scan of one column
+            snapshot.forEachText(field, [&](size_t slot, std::string_view text) {
+                if (contains(text)) matches.push_back(slot);
+            });
+        }
+        if (!sameIsbn.empty()) {
+            std::sort(sameIsbn.begin(), sameIsbn.end());
+            std::vector<size_t> merged;
+            merged.reserve(matches.size() + sameIsbn.size());
+            std::set_union(matches.begin(), matches.end(), sameIsbn.begin(), sameIsbn.end(),
+                           std::back_inserter(merged));
+            matches.swap(merged);
+        }
+        return matches;
+    }
+
+    // Slots of the books in either ID list, in ascending ID order.
+    // Caller holds catalogMutex (shared is enough).
+    std::vector<size_t> slotsOf(const std::vector<int>& titleIds, const std::vector<int>& authorIds) const {
+        std::vector<int> ids;
+        ids.reserve(titleIds.size() + authorIds.size());
+        std::set_union(titleIds.begin(), titleIds.end(), authorIds.begin(), authorIds.end(), std::back_inserter(ids));
+        std::vector<size_t> slots;
+        slots.reserve(ids.size());
+        for (int bookId : ids) {
+            auto it = bookIdToIndex.find(bookId);
+            if (it != bookIdToIndex.end()) slots.push_back(it->second);
+        }
+        return slots;
+    }
+
+    // Per-field match scores for ranked search; title counts double
+    static constexpr int MATCH_EXACT = 3;
+    static constexpr int MATCH_PREFIX = 2;
+    static constexpr int MATCH_SUBSTRING = 1;
+    static constexpr int TITLE_WEIGHT = 2;
+    static constexpr int RANKED_MAX_SCORE = MATCH_EXACT * TITLE_WEIGHT + MATCH_EXACT;
+
+    static int matchScore(std::string_view text, std::string_view folded) {
+        size_t pos = CaseFoldSearch::find(text, folded);
+        if (pos == std::string_view::npos) return 0;
+        if (pos > 0) return MATCH_SUBSTRING;
+        return text.size() == folded.size() ? MATCH_EXACT : MATCH_PREFIX;
+    }
+
+    // Book store column matched by a search type
+    static BookStore::Field fieldFor(const std::string& searchType) {
+        if (searchType == "title") return BookStore::TITLE;
+        if (searchType == "author") return BookStore::AUTHOR;
+        return BookStore::ISBN;
+    }
+
+    struct BatchCounter {
+        size_t ok = 0;
+        size_t failed = 0;
+    };
+
+    // State of one batch run: counters, the open transaction and a buffered output stream
+    struct BatchRun {
+        BatchCounter counters[COMMAND_COUNT];
+        std::string output;
+        bool inTransaction = false;
+        Transaction txn;
+        std::vector<size_t> txnLines;  // batch line of each queued operation
+        const char* txnError = nullptr;  // first line that could not be queued
+        size_t txnErrorLine = 0;
+    };
+
+    static void flushBatchOutput(BatchRun& batch, bool force) {
+        if (force || batch.output.size() >= 64 * 1024) {
+            std::cout.write(batch.output.data(), batch.output.size());
+            if (force) std::cout.flush();
+            batch.output.clear();
+        }
+    }
+
+    static void reportBatchFailure(BatchRun& batch, size_t lineNumber, std::string_view word, const char* error) {
+        batch.output += "line ";
+        batch.output += std::to_string(lineNumber);
+        batch.output += ": ";
+        batch.output.append(word.data(), word.size());
+        batch.output += " failed: ";
+        batch.output += error;
+        batch.output += '\n';
+        flushBatchOutput(batch, false);
+    }
+
+    // Commit the open batch transaction; its operations count as succeeded or failed together
+    void commitBatchTransaction(BatchRun& batch, size_t lineNumber) {
+        const char* error = batch.txnError;
+        size_t errorLine = batch.txnErrorLine;
+        if (!error) {
+            TransactionResult result = commitTransaction(batch.txn);
+            error = result.error;
+            if (error) errorLine = result.failedOp < batch.txnLines.size() ? batch.txnLines[result.failedOp] : lineNumber;
+        }
+        auto count = [error](BatchCounter& counter) { error ? ++counter.failed : ++counter.ok; };
+        for (const Transaction::Op& op : batch.txn.ops()) count(batch.counters[op.command]);
+        count(batch.counters[CMD_COMMIT]);
+        if (error) {
+            std::string reason = std::string(error) + " (line " + std::to_string(errorLine) + "), nothing applied";
+            reportBatchFailure(batch, lineNumber, "COMMIT", reason.c_str());
+        }
+        batch.inTransaction = false;
+        batch.txn.clear();
+        batch.txnLines.clear();
+        batch.txnError = nullptr;
+    }
+
+    // Parse and apply one batch line, recording the outcome. Lines between
+    // BEGIN and COMMIT are queued and applied as one transaction.
+    void executeBatchLine(BatchRun& batch, size_t lineNumber, std::string_view line) {
+        if (line.front() == '#') return;
+
+        size_t space = line.find(' ');
+        std::string_view word = line.substr(0, space);
+        std::string_view rest = space == std::string_view::npos ? std::string_view() : line.substr(space + 1);
+        CommandType command = parseCommand(word);
+
+        if (batch.inTransaction && command != CMD_BEGIN && command != CMD_COMMIT && command != CMD_ABORT) {
+            const char* error = batch.txn.add(command, rest);
+            if (!error) {
+                batch.txnLines.push_back(lineNumber);
+                return;
+            }
+            ++batch.counters[command].failed;
+            if (!batch.txnError) {
+                batch.txnError = error;
+                batch.txnErrorLine = lineNumber;
+            }
+            return;
+        }
+
+        const char* error = nullptr;
+        if (command == CMD_BEGIN) {
+            if (batch.inTransaction) error = "transaction already open";
+            batch.inTransaction = true;
+        } else if (command == CMD_COMMIT || command == CMD_ABORT) {
+            if (!batch.inTransaction) {
+                error = "no open transaction";
+            } else if (command == CMD_COMMIT) {
+                commitBatchTransaction(batch, lineNumber);
+                return;
+            } else {
+                batch.inTransaction = false;
+                batch.txn.clear();
+                batch.txnLines.clear();
+                batch.txnError = nullptr;
+            }
+        } else {
+            error = executeCommand(command, rest).error;
+        }
+
+        BatchCounter& counter = batch.counters[command];
+        if (!error) {
+            ++counter.ok;
+            return;
+        }
+        ++counter.failed;
+        reportBatchFailure(batch, lineNumber, word, error);
+    }
+
+public:
+    // Constructor
+    // A non-persistent system starts empty and never touches the data files
+    explicit LibrarySystem(bool persistentStorage = true, size_t loadThreadCount = 0)
+        : nextBookId(1), nextUserId(1), currentAdmin(nullptr), persistent(persistentStorage),
+          loadThreads(loadThreadCount), journalDamaged(false), syncCommit(true),
+          checkpointThreshold(8 * 1024 * 1024), checkpointFailed(false),
+          flushInterval(DEFAULT_FLUSH_INTERVAL), flushStopping(false), flushRequested(false),
+          booksVersion(0), usersVersion(0), loansVersion(0), holdsVersion(0), booksSavedVersion(0),
+          usersSavedVersion(0), loansSavedVersion(0), holdsSavedVersion(0),
+          flushCount(0), lastFlushNs(0), lastFlushLockedNs(0), lastFlushBytes(0),
+          binarySnapshot(false) {
+        // Create default admin
+        applyPutUser(userPool.create<Admin>(0, "System Admin", "admin@library.com", "admin", "admin123"));
+        
+        if (!persistent) return;
+        loadData();
+        if (journalDamaged) return;
+        if (!journal.open(JOURNAL_FILE)) {
+            std::cout << "Warning: could not open " << JOURNAL_FILE << ", changes are saved on exit only" << std::endl;
+        }
+        flushThread = std::thread(&LibrarySystem::flushLoop, this);
+    }
+
+    // Destructor
+    ~LibrarySystem() {
+        // Let queued operations finish before tearing anything down
+        workers.reset();
+        stopFlushThread();
+        journal.close();
+        // A final full snapshot makes the journal redundant
+        if (persistent && saveData()) {
+            std::remove(JOURNAL_FILE.c_str());
+            std::remove(CHECKPOINT_JOURNAL_FILE.c_str());
+        }
+        for (User* user : users) {
+            userPool.destroy(user);
+        }
+    }
+
+    // Core operations: validate and apply a change without printing.
+    // The interactive methods below wrap these and report the outcome.
+
+    OpResult addBookOp(const std::string& title, const std::string& author, const std::string& isbn) {
+        return timed(OP_ADD_BOOK, [&]() -> OpResult {
+            uint64_t lsn;
+            int id;
+            {
+                ExclusiveLock lock(catalogMutex);
+                id = nextBookId;
+                if (journal.hasFailed()) return OpResult::failure(ERR_JOURNAL, id);
+                if (!isStorableField(title) || !isStorableField(author) || !isStorableField(isbn)) {
+                    return OpResult::failure(ERR_INVALID_FIELD, id);
+                }
+                if (bookWithIsbn(isbn, id) >= 0) return OpResult::failure(ERR_DUPLICATE_ISBN, id);
+                std::vector<UndoStep> undo;
+                lsn = logRecord(addBookLocked(id, title, author, isbn, undo), undo);
+            }
+            return finishCommit(lsn, id);
+        });
+    }
+
+    OpResult addBookOp(int id, const std::string& title, const std::string& author, const std::string& isbn) {
+        return timed(OP_ADD_BOOK, [&]() -> OpResult {
+            uint64_t lsn;
+            {
+                ExclusiveLock lock(catalogMutex);
+                if (journal.hasFailed()) return OpResult::failure(ERR_JOURNAL, id);
+                if (!isStorableField(title) || !isStorableField(author) || !isStorableField(isbn)) {
+                    return OpResult::failure(ERR_INVALID_FIELD, id);
+                }
+                if (bookIdToIndex.count(id)) return OpResult::failure(ERR_DUPLICATE_ID, id);
+                if (bookWithIsbn(isbn, id) >= 0) return OpResult::failure(ERR_DUPLICATE_ISBN, id);
+                std::vector<UndoStep> undo;
+                lsn = logRecord(addBookLocked(id, title, author, isbn, undo), undo);
+            }
+            return finishCommit(lsn, id);
+        });
+    }
+
+    // Empty fields keep their current value
+    OpResult updateBookOp(int bookId, const std::string& title, const std::string& author, const std::string& isbn) {
+        return timed(OP_UPDATE_BOOK, [&]() -> OpResult {
+            uint64_t lsn;
+            {
+                ExclusiveLock lock(catalogMutex);
+                if (journal.hasFailed()) return OpResult::failure(ERR_JOURNAL, bookId);
+                if (!isStorableField(title) || !isStorableField(author) || !isStorableField(isbn)) {
+                    return OpResult::failure(ERR_INVALID_FIELD, bookId);
+                }
+                auto it = bookIdToIndex.find(bookId);
+                if (it == bookIdToIndex.end()) return OpResult::failure(ERR_BOOK_NOT_FOUND, bookId);
+                if (!isbn.empty() && bookWithIsbn(isbn, bookId) >= 0) {
+                    return OpResult::failure(ERR_DUPLICATE_ISBN, bookId);
+                }
+
+                Book book = books[it->second];
+                std::vector<UndoStep> undo;
+                remember(undo, UndoStep::putBook(book));
+                if (!title.empty()) book.setTitle(title);
+                if (!author.empty()) book.setAuthor(author);
+                if (!isbn.empty()) book.setIsbn(isbn);
+                applyPutBook(book);
+                lsn = logRecord("BOOK," + book.toFileString(), undo);
+            }
+            return finishCommit(lsn, bookId);
+        });
+    }
+
+    OpResult deleteBookOp(int bookId) {
+        return timed(OP_DELETE_BOOK, [&]() -> OpResult {
+            uint64_t lsn;
+            {
+                ExclusiveLock lock(catalogMutex);
+                if (journal.hasFailed()) return OpResult::failure(ERR_JOURNAL, bookId);
+                auto it = bookIdToIndex.find(bookId);
+                if (it == bookIdToIndex.end()) return OpResult::failure(ERR_BOOK_NOT_FOUND, bookId);
+                if (books.isIssued(it->second)) return OpResult::failure(ERR_DELETE_ISSUED, bookId);
+
+                std::vector<UndoStep> undo;
+
+                remember(undo, UndoStep::putBook(books[it->second]));
+                applyDeleteBook(bookId);
+                lsn = logRecord("DELETE_BOOK," + std::to_string(bookId), undo);
+            }
+            return finishCommit(lsn, bookId);
+        });
+    }
+
+    // Locks only the catalog (shared) plus this book's and user's stripes
+    OpResult issueBookOp(int bookId, int userId) {
+        return timed(OP_ISSUE_BOOK, [&]() -> OpResult {
+            uint64_t lsn;
+            {
+                SharedLock catalog(catalogMutex);
+                if (journal.hasFailed()) return OpResult::failure(ERR_JOURNAL, bookId);
+                auto bookIt = bookIdToIndex.find(bookId);
+                if (bookIt == bookIdToIndex.end()) return OpResult::failure(ERR_BOOK_NOT_FOUND, bookId);
+                if (userIdToIndex.find(userId) < 0) return OpResult::failure(ERR_USER_NOT_FOUND, bookId);
+
+                std::lock_guard<std::mutex> bookGuard(bookLock(bookId));
+                if (books.isIssued(bookIt->second)) return OpResult::failure(ERR_ALREADY_ISSUED, bookId);
+                std::lock_guard<std::mutex> userGuard(userLock(userId));
+
+                std::vector<UndoStep> undo;
+                lsn = logRecord(issueLocked(bookId, userId, undo), undo);
+            }
+            return finishCommit(lsn, bookId);
+        });
+    }
+
+    // Locks only the catalog (shared) plus this book's and its borrower's
+    // stripes. If patrons are waiting, the book goes straight to the first in
+    // line, whose stripe is locked too (both user stripes at once, so two
+    // handoffs between the same patrons cannot deadlock).
+    OpResult returnBookOp(int bookId) {
+        return timed(OP_RETURN_BOOK, [&]() -> OpResult {
+            uint64_t lsn;
+            {
+                SharedLock catalog(catalogMutex);
+                if (journal.hasFailed()) return OpResult::failure(ERR_JOURNAL, bookId);
+                auto bookIt = bookIdToIndex.find(bookId);
+                if (bookIt == bookIdToIndex.end()) return OpResult::failure(ERR_BOOK_NOT_FOUND, bookId);
+
+                std::lock_guard<std::mutex> bookGuard(bookLock(bookId));
+                if (!books.isIssued(bookIt->second)) return OpResult::failure(ERR_NOT_ISSUED, bookId);
+                int userId = books.issuedToUserId(bookIt->second);
+                // A book's line only changes under its stripe, so the head stays put
+                Hold next;
+                bool handOff = holds.front(bookId, next);
+                std::unique_lock<std::mutex> userGuard(userLock(userId), std::defer_lock);
+                std::unique_lock<std::mutex> holderGuard;
+                if (handOff && &userLock(next.userId) != userGuard.mutex()) {
+                    holderGuard = std::unique_lock<std::mutex>(userLock(next.userId), std::defer_lock);
+                    std::lock(userGuard, holderGuard);
+                } else {
+                    userGuard.lock();
+                }
+
+                // A handoff is journaled as one record with the return
+                std::vector<std::string> records;
+                std::vector<UndoStep> undo;
+                returnLocked(bookId, userId, records, undo);
+                lsn = logRecords(records, undo);
+            }
+            return finishCommit(lsn, bookId);
+        });
+    }
+
+    // Join the line for a book that is on loan; the result's id is the hold ID
+    OpResult placeHoldOp(int bookId, int userId) {
+        return timed(OP_PLACE_HOLD, [&]() -> OpResult {
+            uint64_t lsn;
+            int holdId;
+            {
+                SharedLock catalog(catalogMutex);
+                if (journal.hasFailed()) return OpResult::failure(ERR_JOURNAL, 0);
+                auto bookIt = bookIdToIndex.find(bookId);
+                if (bookIt == bookIdToIndex.end()) return OpResult::failure(ERR_BOOK_NOT_FOUND, 0);
+                if (userIdToIndex.find(userId) < 0) return OpResult::failure(ERR_USER_NOT_FOUND, 0);
+
+                std::lock_guard<std::mutex> bookGuard(bookLock(bookId));
+                // An available book is simply issued; there is nothing to wait for
+                if (!books.isIssued(bookIt->second)) return OpResult::failure(ERR_NOT_ISSUED, 0);
+                if (books.issuedToUserId(bookIt->second) == userId) return OpResult::failure(ERR_HOLD_OWN_LOAN, 0);
+                std::lock_guard<std::mutex> userGuard(userLock(userId));
+                size_t userHolds = 0;
+                if (holds.holdOf(userId, bookId, userHolds)) return OpResult::failure(ERR_ALREADY_HOLDING, 0);
+                if (userHolds >= MAX_HOLDS_PER_USER) return OpResult::failure(ERR_HOLD_LIMIT, 0);
+
+                int64_t now = currentTime();
+                holdId = holds.place(bookId, userId, now);
+                holdsVersion.fetch_add(1, std::memory_order_relaxed);
+                std::vector<UndoStep> undo;
+                remember(undo, UndoStep::endHold(holdId));
+                lsn = logRecord("HOLD," + std::to_string(holdId) + "," + std::to_string(bookId) + "," +
+                                std::to_string(userId) + "," + std::to_string(now), undo);
+            }
+            return finishCommit(lsn, holdId);
+        });
+    }
+
+    // Apply a transaction all-or-nothing. Every operation is checked against
+    // the tables first, in order, as if the earlier ones had been applied (a
+    // return hands the book to the next in line); only if all would succeed
+    // are they applied, and they are journaled as one record. The catalog is
+    // locked exclusively, so no reader sees part of a transaction, but only
+    // while validating and applying: the fsync wait happens after unlocking,
+    // where concurrent transactions share it (group commit). If the journal
+    // write fails the applied operations are rolled back before returning, so
+    // a failed result always means nothing was applied; failedOp is then
+    // txn.size(), as no single operation is to blame.
+    TransactionResult commitTransaction(const Transaction& txn) {
+        OperationTimer timer(stats[OP_TRANSACTION]);
+        TransactionResult result;
+        uint64_t lsn = 0;
+        {
+            ExclusiveLock lock(catalogMutex);
+            const char* error = journal.hasFailed() ? ERR_JOURNAL : nullptr;
+            size_t failedOp = error ? txn.size() : validateTransaction(txn, error);
+            if (error) {
+                timer.fail(error);
+                return TransactionResult::failure(error, failedOp);
+            }
+
+            std::vector<std::string> records;
+            std::vector<UndoStep> undo;
+            records.reserve(txn.size());
+            result.ids.reserve(txn.size());
+            CatalogVersions::WriteScope versions(catalogVersions);
+            for (const Transaction::Op& op : txn.ops()) {
+                switch (op.command) {
+                    case CMD_ISSUE:
+                        records.push_back(issueLocked(op.bookId, op.userId, undo));
+                        result.ids.push_back(op.bookId);
+                        break;
+                    case CMD_RETURN:
+                        returnLocked(op.bookId, books.issuedToUserId(bookIdToIndex[op.bookId]), records, undo);
+                        result.ids.push_back(op.bookId);
+                        break;
+                    case CMD_ADD_BOOK:
+                        result.ids.push_back(nextBookId);
+                        records.push_back(addBookLocked(nextBookId, op.fields[0], op.fields[1], op.fields[2], undo));
+                        break;
+                    default: {
+                        User* added = userPool.create<User>(nextUserId, op.fields[0], op.fields[1]);
+                        applyPutUser(added);
+                        remember(undo, UndoStep::removeUser(added->getUserId()));
+                        result.ids.push_back(added->getUserId());
+                        records.push_back("USER," + added->toFileString());
+                        break;
+                    }
+                }
+            }
+            if (!records.empty()) lsn = logRecords(records, undo);
+        }
+        if (!finishCommit(lsn, 0).ok) {
+            timer.fail(ERR_JOURNAL);
+            result.ok = false;
+            result.error = ERR_JOURNAL;
+            result.failedOp = txn.size();
+        }
+        return result;
+    }
+
+    // Leave a line; locks the hold's book and user stripes
+    OpResult cancelHoldOp(int holdId) {
+        return timed(OP_CANCEL_HOLD, [&]() -> OpResult {
+            uint64_t lsn;
+            {
+                SharedLock catalog(catalogMutex);
+                if (journal.hasFailed()) return OpResult::failure(ERR_JOURNAL, holdId);
+                Hold hold;
+                if (!holds.find(holdId, hold)) return OpResult::failure(ERR_HOLD_NOT_FOUND, holdId);
+                std::lock_guard<std::mutex> bookGuard(bookLock(hold.bookId));
+                std::lock_guard<std::mutex> userGuard(userLock(hold.userId));
+                // The hold may have been filled by a return before the stripes were taken
+                if (!holds.end(holdId, &hold)) return OpResult::failure(ERR_HOLD_NOT_FOUND, holdId);
+                holdsVersion.fetch_add(1, std::memory_order_relaxed);
+                std::vector<UndoStep> undo;
+                remember(undo, UndoStep::restoreHold(hold));
+                lsn = logRecord("END_HOLD," + std::to_string(holdId), undo);
+            }
+            return finishCommit(lsn, holdId);
+        });
+    }
+
+    OpResult addUserOp(const std::string& name, const std::string& email, bool isAdmin = false,
+                       const std::string& username = "", const std::string& password = "") {
+        return timed(OP_ADD_USER, [&]() -> OpResult {
+            if (!isStorableField(name) || !isStorableField(email) || !isStorableField(username)) {
+                return OpResult::failure(ERR_INVALID_FIELD, 0);
+            }
+            // Password hashing is deliberately slow, so it happens before locking
+            Admin admin = isAdmin ? Admin(0, name, email, username, password) : Admin();
+            uint64_t lsn;
+            int id;
+            {
+                ExclusiveLock lock(catalogMutex);
+                if (journal.hasFailed()) return OpResult::failure(ERR_JOURNAL, 0);
+                if (isAdmin && adminsByUsername.count(username)) return OpResult::failure(ERR_USERNAME_TAKEN, 0);
+                id = nextUserId;
+                User* added = isAdmin ? static_cast<User*>(userPool.create<Admin>(std::move(admin)))
+                                      : userPool.create<User>(id, name, email);
+                added->setUserId(id);
+                applyPutUser(added);
+                std::vector<UndoStep> undo;
+                remember(undo, UndoStep::removeUser(id));
+                lsn = logRecord("USER," + added->toFileString(), undo);
+            }
+            return finishCommit(lsn, id);
+        });
+    }
+
+    // IDs of books matching a search, in catalog order, without printing
+    std::vector<int> searchBookIds(const std::string& query, const std::string& searchType,
+                                   bool ignoreCase = false) const {
+        OperationTimer timer(stats[OP_SEARCH_BOOKS]);
+        CatalogVersions::Snapshot snapshot;
+        std::vector<int> ids;
+        for (size_t slot : matchingSlots(query, searchType, ignoreCase, snapshot)) {
+            ids.push_back(snapshot.bookId(slot));
+        }
+        return ids;
+    }
+
+    // Copies of books matching a search, in catalog order, all as of one version
+    std::vector<Book> findBooks(const std::string& query, const std::string& searchType,
+                                bool ignoreCase = false) const {
+        OperationTimer timer(stats[OP_SEARCH_BOOKS]);
+        CatalogVersions::Snapshot snapshot;
+        std::vector<Book> results;
+        for (size_t slot : matchingSlots(query, searchType, ignoreCase, snapshot)) {
+            results.push_back(snapshot[slot]);
+        }
+        return results;
+    }
+
+    // Best `limit` books whose title or author contains the query (ignoring
+    // ASCII case) ranked after `after`: exact > prefix > substring match, title
+    // weighted over author. Only limit + 1 hits are ever held, and an indexed
+    // query stops early once nothing left can outrank the page.
+    RankedPage rankedSearch(const std::string& query, size_t limit, const SearchCursor& after = SearchCursor()) const {
+        OperationTimer timer(stats[OP_SEARCH_BOOKS]);
+        RankedPage page;
+        if (limit == 0 || query.empty()) return page;
+        const std::string folded = CaseFoldSearch::fold(query);
+        const int bound = std::min(RANKED_MAX_SCORE, after.score);
+
+        // Worst kept hit on top; the extra slot tells whether another page exists
+        auto better = [](const RankedHit& a, const RankedHit& b) { return a.ranksBefore(b); };
+        std::priority_queue<RankedHit, std::vector<RankedHit>, decltype(better)> heap(better);
+        CatalogVersions::Snapshot snapshot;
+        auto consider = [&](size_t slot) {
+            RankedHit hit{snapshot.bookId(slot), 0, snapshot.text(BookStore::TITLE, slot),
+                          snapshot.text(BookStore::AUTHOR, slot)};
+            hit.score = matchScore(hit.title, folded) * TITLE_WEIGHT + MATCH_EXACT;
+            // Skip the author search when even an exact author match would not make the page
+            if (heap.size() > limit && !better(hit, heap.top())) return;
+            hit.score += matchScore(hit.author, folded) - MATCH_EXACT;
+            if (hit.score == 0 || !after.precedes(hit)) return;
+            if (heap.size() <= limit) {
+                heap.push(hit);
+            } else if (better(hit, heap.top())) {
+                heap.pop();
+                heap.push(hit);
+            }
+        };
+
+        // Candidates are found under the lock and scored in the snapshot after
+        bool indexed = query.size() >= TrigramIndex::MIN_QUERY_LENGTH;
+        std::vector<size_t> slots;
+        {
+            SharedLock catalog(catalogMutex);
+            snapshot = catalogVersions.pin();
+            if (indexed) slots = slotsOf(titleIndex.candidates(query), authorIndex.candidates(query));
+        }
+        if (indexed) {
+            for (size_t slot : slots) {
+                // IDs ascend, so a full heap already at the best reachable score cannot change
+                if (heap.size() > limit && heap.top().score >= bound) break;
+                consider(slot);
+            }
+        } else {
+            // Short queries scan every slot; slot order is not ID order, so no early exit
+            snapshot.forEachLive(consider);
+        }
+
+        page.hits.reserve(heap.size());
+        for (; !heap.empty(); heap.pop()) page.hits.push_back(heap.top());
+        std::reverse(page.hits.begin(), page.hits.end());
+        if (page.hits.size() > limit) {
+            page.hits.pop_back();
+            page.hasMore = true;
+        }
+        if (!page.hits.empty()) {
+            page.next.score = page.hits.back().score;
+            page.next.bookId = page.hits.back().bookId;
+        }
+        return page;
+    }
+
+    // Up to `limit` distinct titles or authors starting with the prefix,
+    // ignoring ASCII case, in alphabetical order. Views stay valid for the
+    // life of the process.
+    std::vector<std::string_view> autocomplete(const std::string& prefix, const std::string& searchType,
+                                               size_t limit) const {
+        OperationTimer timer(stats[OP_AUTOCOMPLETE]);
+        SharedLock catalog(catalogMutex);
+        if (searchType == "title") return titleCompletions.complete(prefix, limit);
+        if (searchType == "author") return authorCompletions.complete(prefix, limit);
+        return std::vector<std::string_view>();
+    }
+
+    // Edits a fuzzy search tolerates by default: none for very short queries,
+    // one typo for a word, two for longer phrases
+    static int defaultFuzzyDistance(size_t queryLength) {
+        if (queryLength < 4) return 0;
+        return queryLength < 12 ? 1 : 2;
+    }
+
+    // Books whose title or author contains the query within `maxDistance`
+    // edits (adjacent swaps count once), ignoring ASCII case, closest first.
+    // Candidates come from the trigram indices when they can rule books out,
+    // otherwise both columns are scanned.
+    std::vector<FuzzyHit> fuzzySearch(const std::string& query, int maxDistance, size_t limit) const {
+        OperationTimer timer(stats[OP_SEARCH_BOOKS]);
+        std::vector<FuzzyHit> hits;
+        if (query.empty() || limit == 0) return hits;
+        // The matcher only sees the first 64 bytes, so the filter uses the same
+        std::string_view pattern = std::string_view(query).substr(0, FuzzyMatcher::MAX_PATTERN_LENGTH);
+        FuzzyMatcher matcher(pattern);
+        maxDistance = std::min(maxDistance, static_cast<int>(matcher.patternLength()) - 1);
+        if (maxDistance < 0) return hits;
+
+        CatalogVersions::Snapshot snapshot;
+        auto consider = [&](size_t slot) {
+            FuzzyHit hit{snapshot.bookId(slot), 0, snapshot.text(BookStore::TITLE, slot),
+                         snapshot.text(BookStore::AUTHOR, slot)};
+            hit.distance = matcher.distance(hit.title);
+            if (hit.distance > 0) hit.distance = std::min(hit.distance, matcher.distance(hit.author));
+            if (hit.distance <= maxDistance) hits.push_back(hit);
+        };
+
+        std::vector<int> titleIds, authorIds;
+        std::vector<size_t> slots;
+        bool indexed;
+        {
+            SharedLock catalog(catalogMutex);
+            snapshot = catalogVersions.pin();
+            indexed = titleIndex.fuzzyCandidates(pattern, maxDistance, titleIds) &&
+                      authorIndex.fuzzyCandidates(pattern, maxDistance, authorIds);
+            if (indexed) slots = slotsOf(titleIds, authorIds);
+        }
+        if (indexed) {
+            for (size_t slot : slots) consider(slot);
+        } else {
+            snapshot.forEachLive(consider);
+        }
+
+        auto closer = [](const FuzzyHit& a, const FuzzyHit& b) { return a.ranksBefore(b); };
+        if (hits.size() > limit) {
+            std::partial_sort(hits.begin(), hits.begin() + limit, hits.end(), closer);
+            hits.resize(limit);
+        } else {
+            std::sort(hits.begin(), hits.end(), closer);
+        }
+        return hits;
+    }
+
+    // ID of the book with this ISBN-10 or ISBN-13 (hyphens allowed), or -1
+    int findBookByIsbn(const std::string& isbn) const {
+        OperationTimer timer(stats[OP_SEARCH_BOOKS]);
+        uint64_t key = isbnKey(isbn);
+        if (key == 0) return -1;
+        SharedLock catalog(catalogMutex);
+        return isbnKeys.findOther(key, -1);
+    }
+
+    // Open loans due before `asOf` (Unix seconds), earliest due first.
+    // Cost grows with the number of overdue loans, not the catalog.
+    std::vector<Loan> overdueLoans(int64_t asOf) const {
+        OperationTimer timer(stats[OP_OVERDUE_LOANS]);
+        return ledger.dueBefore(asOf);
+    }
+
+    // The open loan of a book, if it is on loan
+    bool currentLoan(int bookId, Loan& loan) const { return ledger.openLoanFor(bookId, loan); }
+
+    // Patrons waiting for a book, first in line first
+    std::vector<Hold> holdQueue(int bookId) const { return holds.queueFor(bookId); }
+
+    size_t holdQueueLength(int bookId) const { return holds.queueLength(bookId); }
+
+    // Checksum of the book and user tables in file order, for checking that two
+    // loads agree. The built-in admin is left out since its password salt is random.
+    uint32_t contentChecksum() const {
+        SharedLock catalog(catalogMutex);
+        std::string text;
+        serializeBooks(catalogVersions.pin(), text);
+        uint32_t hash = checksum32(text);
+        for (const User* user : users) {
+            if (user->getUserId() != 0) hash = checksum32(user->toFileString(), hash);
+        }
+        return hash;
+    }
+
+    // Cross-check the tables: every issued book is on its borrower's list and
+    // has an open loan to them, and there are no other entries or loans.
+    // Returns the first problem found, or an empty string.
+    std::string checkConsistency() const {
+        ExclusiveLock catalog(catalogMutex);
+        size_t issued = 0;
+        for (const auto& book : books) {
+            if (!book.getIsIssued()) continue;
+            ++issued;
+            std::string which = "book " + std::to_string(book.getBookId());
+            int index = userIdToIndex.find(book.getIssuedToUserId());
+            if (index < 0) return which + " is issued to an unknown user";
+            const std::vector<int>& list = users[index]->getIssuedBooks();
+            if (std::find(list.begin(), list.end(), book.getBookId()) == list.end()) {
+                return which + " is missing from its borrower's list";
+            }
+            Loan loan;
+            if (!ledger.openLoanFor(book.getBookId(), loan) || loan.userId != book.getIssuedToUserId()) {
+                return which + " has no open loan to its borrower";
+            }
+        }
+        size_t listed = 0;
+        for (const User* user : users) listed += user->getIssuedBooks().size();
+        size_t openLoans = 0;
+        ledger.forEachOpen([&](const Loan&) { ++openLoans; });
+        if (listed != issued) return std::to_string(listed) + " books on users' lists, " + std::to_string(issued) + " issued";
+        if (openLoans != issued) return std::to_string(openLoans) + " open loans, " + std::to_string(issued) + " issued";
+        if (catalogVersions.pin().issuedCount() != issued) return "the published catalog version disagrees";
+        return std::string();
+    }
+
+    // Copies of every book, in catalog order, as of one version
+    std::vector<Book> getAllBooks() const {
+        OperationTimer timer(stats[OP_VIEW_BOOKS]);
+        CatalogVersions::Snapshot snapshot = catalogVersions.pin();
+        std::vector<Book> results;
+        results.reserve(snapshot.size());
+        snapshot.forEachLive([&](size_t slot) { results.push_back(snapshot[slot]); });
+        return results;
+    }
+
+    // The latest committed version of the book table, for scans and exports
+    // of any length; it stays unchanged while writers carry on. Release it
+    // when done, so the versions it holds can be freed.
+    CatalogVersions::Snapshot catalogSnapshot() const { return catalogVersions.pin(); }
+
+    // With synchronous commit off, operations return once journaled in memory;
+    // the caller makes them durable in groups with syncJournal()
+    void setSyncCommit(bool enabled) { syncCommit = enabled; }
+
+    bool syncJournal() {
+        if (!journal.isOpen() || journal.sync()) return true;
+        rollBackUndurable();
+        return false;
+    }
+
+    // Journal records appended and fsyncs issued so far
+    std::pair<uint64_t, uint64_t> journalCommitCounts() { return journal.commitCounts(); }
+
+    // LSN up to which every journal record is on disk
+    uint64_t journalDurableThrough() { return journal.durableThrough(); }
+
+    // How often the background flusher writes changed tables to the snapshot
+    // files; zero leaves it to the journal size threshold
+    void setFlushInterval(std::chrono::milliseconds interval) {
+        {
+            std::lock_guard<std::mutex> lock(flushMutex);
+            flushInterval = std::max(interval, std::chrono::milliseconds(0));
+        }
+        flushWake.notify_one();
+    }
+
+    std::chrono::milliseconds getFlushInterval() {
+        std::lock_guard<std::mutex> lock(flushMutex);
+        return flushInterval;
+    }
+
+    // Duration of the most recent background flush in nanoseconds (0 before the first)
+    uint64_t lastFlushDuration() const { return lastFlushNs.load(); }
+
+    // Parse a text command's arguments and apply it (see runBatch for the syntax).
+    // Used by batch mode and the network server.
+    OpResult executeCommand(CommandType command, std::string_view rest) {
+        std::string_view args[4];
+        int first = 0, second = 0;
+        switch (command) {
+            case CMD_ADD_BOOK:
+                if (splitFields(rest, '|', args, 3) != 3) return OpResult::failure("expected title|author|isbn", 0);
+                return addBookOp(std::string(args[0]), std::string(args[1]), std::string(args[2]));
+            case CMD_UPDATE_BOOK: {
+                size_t idEnd = rest.find(' ');
+                if (!parseInt(rest.substr(0, idEnd), first) || idEnd == std::string_view::npos ||
+                    splitFields(rest.substr(idEnd + 1), '|', args, 3) != 3) {
+                    return OpResult::failure("expected id title|author|isbn", 0);
+                }
+                return updateBookOp(first, std::string(args[0]), std::string(args[1]), std::string(args[2]));
+            }
+            case CMD_DELETE_BOOK:
+                if (!parseInt(rest, first)) return OpResult::failure("expected book id", 0);
+                return deleteBookOp(first);
+            case CMD_ISSUE:
+                if (splitFields(rest, ' ', args, 2) != 2 || !parseInt(args[0], first) || !parseInt(args[1], second)) {
+                    return OpResult::failure("expected book id and user id", 0);
+                }
+                return issueBookOp(first, second);
+            case CMD_RETURN:
+                if (!parseInt(rest, first)) return OpResult::failure("expected book id", 0);
+                return returnBookOp(first);
+            case CMD_ADD_USER:
+                if (splitFields(rest, '|', args, 2) != 2) return OpResult::failure("expected name|email", 0);
+                return addUserOp(std::string(args[0]), std::string(args[1]));
+            case CMD_ADD_ADMIN:
+                if (splitFields(rest, '|', args, 4) != 4) {
+                    return OpResult::failure("expected name|email|username|password", 0);
+                }
+                return addUserOp(std::string(args[0]), std::string(args[1]), true,
+                                 std::string(args[2]), std::string(args[3]));
+            case CMD_HOLD:
+                if (splitFields(rest, ' ', args, 2) != 2 || !parseInt(args[0], first) || !parseInt(args[1], second)) {
+                    return OpResult::failure("expected book id and user id", 0);
+                }
+                return placeHoldOp(first, second);
+            case CMD_CANCEL_HOLD:
+                if (!parseInt(rest, first)) return OpResult::failure("expected hold id", 0);
+                return cancelHoldOp(first);
+            default:
+                return OpResult::failure("unknown command", 0);
+        }
+    }
+
+    // Name of a user, or an empty string if there is no such user
+    std::string getUserName(int userId) const {
+        SharedLock catalog(catalogMutex);
+        int index = userIdToIndex.find(userId);
+        return index < 0 ? std::string() : users[index]->getName();
+    }
+
+    // Start (or resize) the worker pool used by submit()
+    void setWorkerThreads(size_t threadCount) {
+        workers.reset(new ThreadPool(threadCount));
+    }
+
+    size_t getWorkerThreads() const {
+        return workers ? workers->size() : 0;
+    }
+
+    // Run an operation on the worker pool, e.g. submit([&] { return lib.issueBookOp(1, 2); })
+    template <typename F>
+    auto submit(F&& fn) -> std::future<decltype(fn())> {
+        if (!workers) setWorkerThreads(std::max(1u, std::thread::hardware_concurrency()));
+        return workers->submit(std::forward<F>(fn));
+    }
+
+    // Function overloading for adding books
+    void addBook(const std::string& title, const std::string& author, const std::string& isbn) {
+        printAddBookResult(addBookOp(title, author, isbn));
+    }
+
+    void addBook(int id, const std::string& title, const std::string& author, const std::string& isbn) {
+        printAddBookResult(addBookOp(id, title, author, isbn));
+    }
+
+    static void printAddBookResult(const OpResult& result) {
+        if (result.ok) {
+            std::cout << "Book added successfully!" << std::endl;
+        } else {
+            std::cout << "Error adding book: " << result.error << std::endl;
+        }
+    }
+
+    // View all books, as of one version: writers are not held up while the
+    // listing prints, and the totals match the rows shown
+    void viewBooks() const {
+        OperationTimer timer(stats[OP_VIEW_BOOKS]);
+        CatalogVersions::Snapshot snapshot = catalogVersions.pin();
+        if (snapshot.empty()) {
+            std::cout << "No books available in the library." << std::endl;
+            return;
+        }
+
+        std::cout << "\n" << std::string(90, '=') << std::endl;
+        std::cout << "LIBRARY BOOKS" << std::endl;
+        std::cout << std::string(90, '=') << std::endl;
+        std::cout << std::left << std::setw(5) << "ID" 
+                  << std::setw(25) << "Title" 
+                  << std::setw(20) << "Author" 
+                  << std::setw(15) << "ISBN" 
+                  << std::setw(10) << "Status"
+                  << std::setw(10) << "User ID" << std::endl;
+        std::cout << std::string(90, '-') << std::endl;
+
+        snapshot.forEachLive([&](size_t slot) {
+            snapshot[slot].display(); // Polymorphism in action
+        });
+        std::cout << std::string(90, '=') << std::endl;
+
+        std::cout << "Total: " << snapshot.size() << " books, " << snapshot.size() - snapshot.issuedCount()
+                  << " available, " << snapshot.issuedCount() << " issued" << std::endl;
+    }
+
+    // Total and issued book counts of the latest version, kept up to date by every write
+    std::pair<size_t, size_t> bookCounts() const {
+        CatalogVersions::Snapshot snapshot = catalogVersions.pin();
+        return std::make_pair(snapshot.size(), snapshot.issuedCount());
+    }
+
+    // Search books (function overloading)
+    void searchBooks(const std::string& query, const std::string& searchType, bool ignoreCase = false) {
+        std::vector<Book> results = findBooks(query, searchType, ignoreCase);
+        if (results.empty()) {
+            std::cout << "No books found matching your search criteria." << std::endl;
+            return;
+        }
+
+        std::cout << "\nSearch Results:" << std::endl;
+        std::cout << std::string(90, '-') << std::endl;
+        std::cout << std::left << std::setw(5) << "ID" 
+                  << std::setw(25) << "Title" 
+                  << std::setw(20) << "Author" 
+                  << std::setw(15) << "ISBN" 
+                  << std::setw(10) << "Status" << std::endl;
+        std::cout << std::string(90, '-') << std::endl;
+
+        for (const auto& book : results) {
+            book.display();
+        }
+    }
+
+    // Ranked title/author search, shown one page at a time
+    void browseRankedSearch(const std::string& query) {
+        const size_t PAGE_SIZE = 10;
+        SearchCursor cursor;
+        for (size_t shown = 0;;) {
+            RankedPage page = rankedSearch(query, PAGE_SIZE, cursor);
+            if (page.hits.empty() && shown == 0) {
+                std::cout << "No books found matching your search criteria." << std::endl;
+                return;
+            }
+            if (shown == 0) {
+                std::cout << "\nBest Matches:" << std::endl;
+                std::cout << std::string(60, '-') << std::endl;
+                std::cout << std::left << std::setw(7) << "ID" << std::setw(7) << "Score" << std::setw(25) << "Title"
+                          << std::setw(20) << "Author" << std::endl;
+                std::cout << std::string(60, '-') << std::endl;
+            }
+            for (const auto& hit : page.hits) {
+                std::cout << std::left << std::setw(7) << hit.bookId << std::setw(7) << hit.score << std::setw(25)
+                          << hit.title.substr(0, 24) << std::setw(20) << hit.author.substr(0, 19) << std::endl;
+            }
+            shown += page.hits.size();
+            if (!page.hasMore) return;
+
+            std::string answer;
+            std::cout << "Show more? (y/n): ";
+            std::cin >> answer;
+            if (answer != "y" && answer != "Y") return;
+            cursor = page.next;
+        }
+    }
+
+    // Typo-tolerant title/author search, closest matches first
+    void fuzzySearchBooks(const std::string& query) {
+        const size_t MAX_RESULTS = 20;
+        int maxDistance = defaultFuzzyDistance(query.size());
+        std::vector<FuzzyHit> hits = fuzzySearch(query, maxDistance, MAX_RESULTS);
+        if (hits.empty()) {
+            std::cout << "No books found within " << maxDistance << " typo(s) of your search." << std::endl;
+            return;
+        }
+
+        std::cout << "\nClosest Matches (up to " << maxDistance << " typo(s)):" << std::endl;
+        std::cout << std::string(60, '-') << std::endl;
+        std::cout << std::left << std::setw(7) << "ID" << std::setw(7) << "Typos" << std::setw(25) << "Title"
+                  << std::setw(20) << "Author" << std::endl;
+        std::cout << std::string(60, '-') << std::endl;
+        for (const auto& hit : hits) {
+            std::cout << std::left << std::setw(7) << hit.bookId << std::setw(7) << hit.distance << std::setw(25)
+                      << hit.title.substr(0, 24) << std::setw(20) << hit.author.substr(0, 19) << std::endl;
+        }
+    }
+
+    // Update book
+    void updateBook(int bookId) {
+        Book book;
+        {
+            SharedLock catalog(catalogMutex);
+            auto it = bookIdToIndex.find(bookId);
+            if (it == bookIdToIndex.end()) {
+                std::cout << "Error updating book: " << ERR_BOOK_NOT_FOUND << std::endl;
+                return;
+            }
+            book = snapshotBook(it->second);
+        }
+        std::string title, author, isbn;
+
+        std::cout << "Current Title: " << book.getTitle() << std::endl;
+        std::cout << "Enter new title (or press Enter to keep current): ";
+        std::cin.ignore();
+        std::getline(std::cin, title);
+
+        std::cout << "Current Author: " << book.getAuthor() << std::endl;
+        std::cout << "Enter new author (or press Enter to keep current): ";
+        std::getline(std::cin, author);
+
+        std::cout << "Current ISBN: " << book.getIsbn() << std::endl;
+        std::cout << "Enter new ISBN (or press Enter to keep current): ";
+        std::getline(std::cin, isbn);
+
+        OpResult result = updateBookOp(bookId, title, author, isbn);
+        if (result.ok) {
+            std::cout << "Book updated successfully!" << std::endl;
+        } else {
+            std::cout << "Error updating book: " << result.error << std::endl;
+        }
+    }
+
+    // Delete book
+    void deleteBook(int bookId) {
+        OpResult result = deleteBookOp(bookId);
+        if (result.ok) {
+            std::cout << "Book deleted successfully!" << std::endl;
+        } else {
+            std::cout << "Error deleting book: " << result.error << std::endl;
+        }
+    }
+
+    // Issue book
+    void issueBook(int bookId, int userId) {
+        OpResult result = issueBookOp(bookId, userId);
+        Loan loan;
+        if (result.ok && currentLoan(bookId, loan)) {
+            std::cout << "Book issued successfully to " << getUserName(userId) << ", due back "
+                      << formatDate(loan.dueAt) << std::endl;
+        } else if (result.ok) {
+            std::cout << "Book issued successfully to " << getUserName(userId) << std::endl;
+        } else {
+            std::cout << "Error issuing book: " << result.error << std::endl;
+            if (result.error == ERR_ALREADY_ISSUED) {
+                std::cout << holdQueueLength(bookId) << " patron(s) waiting; use Place Hold to join the line"
+                          << std::endl;
+            }
+        }
+    }
+
+    // Return book
+    void returnBook(int bookId) {
+        OpResult result = returnBookOp(bookId);
+        Loan loan;
+        if (result.ok && currentLoan(bookId, loan)) {
+            std::cout << "Book returned successfully! Issued to " << getUserName(loan.userId)
+                      << ", who was first in line, due back " << formatDate(loan.dueAt) << std::endl;
+        } else if (result.ok) {
+            std::cout << "Book returned successfully!" << std::endl;
+        } else {
+            std::cout << "Error returning book: " << result.error << std::endl;
+        }
+    }
+
+    // Place hold
+    void placeHold(int bookId, int userId) {
+        OpResult result = placeHoldOp(bookId, userId);
+        if (result.ok) {
+            std::cout << "Hold " << result.id << " placed for " << getUserName(userId) << ", number "
+                      << holdQueueLength(bookId) << " in line" << std::endl;
+        } else {
+            std::cout << "Error placing hold: " << result.error << std::endl;
+        }
+    }
+
+    // Cancel hold
+    void cancelHold(int holdId) {
+        OpResult result = cancelHoldOp(holdId);
+        if (result.ok) {
+            std::cout << "Hold cancelled successfully!" << std::endl;
+        } else {
+            std::cout << "Error cancelling hold: " << result.error << std::endl;
+        }
+    }
+
+    // Loans past their due date right now, most overdue first
+    void viewOverdueLoans() {
+        int64_t now = currentTime();
+        std::vector<Loan> overdue = overdueLoans(now);
+        if (overdue.empty()) {
+            std::cout << "No overdue loans." << std::endl;
+            return;
+        }
+
+        std::cout << "\n" << std::string(90, '=') << std::endl;
+        std::cout << "OVERDUE LOANS" << std::endl;
+        std::cout << std::string(90, '=') << std::endl;
+        std::cout << std::left << std::setw(8) << "Loan"
+                  << std::setw(7) << "Book"
+                  << std::setw(25) << "Title"
+                  << std::setw(20) << "Borrower"
+                  << std::setw(12) << "Due"
+                  << std::setw(10) << "Days late" << std::endl;
+        std::cout << std::string(90, '-') << std::endl;
+        for (const Loan& loan : overdue) {
+            std::string title;
+            {
+                SharedLock catalog(catalogMutex);
+                auto it = bookIdToIndex.find(loan.bookId);
+                if (it != bookIdToIndex.end()) title = std::string(books.text(BookStore::TITLE, it->second));
+            }
+            std::cout << std::left << std::setw(8) << loan.loanId
+                      << std::setw(7) << loan.bookId
+                      << std::setw(25) << title.substr(0, 24)
+                      << std::setw(20) << getUserName(loan.userId).substr(0, 19)
+                      << std::setw(12) << formatDate(loan.dueAt)
+                      << std::setw(10) << (now - loan.dueAt) / (24 * 60 * 60) << std::endl;
+        }
+        std::cout << std::string(90, '=') << std::endl;
+        std::cout << "Total: " << overdue.size() << " overdue loans" << std::endl;
+    }
+
+    // Add user
+    void addUser(const std::string& name, const std::string& email, bool isAdmin = false, 
+                 const std::string& username = "", const std::string& password = "") {
+        OpResult result = addUserOp(name, email, isAdmin, username, password);
+        if (result.ok) {
+            std::cout << (isAdmin ? "Admin" : "User") << " added successfully!" << std::endl;
+        } else {
+            std::cout << "Error adding user: " << result.error << std::endl;
+        }
+    }
+
+    // View all users
+    void viewUsers() const {
+        OperationTimer timer(stats[OP_VIEW_USERS]);
+        SharedLock catalog(catalogMutex);
+        if (users.empty()) {
+            std::cout << "No users registered in the system." << std::endl;
+            return;
+        }
+
+        std::cout << "\n" << std::string(80, '=') << std::endl;
+        std::cout << "REGISTERED USERS" << std::endl;
+        std::cout << std::string(80, '=') << std::endl;
+        std::cout << std::left << std::setw(5) << "ID" 
+                  << std::setw(20) << "Name" 
+                  << std::setw(25) << "Email" 
+                  << std::setw(15) << "Type"
+                  << std::setw(10) << "Books" << std::endl;
+        std::cout << std::string(80, '-') << std::endl;
+
+        for (const auto& user : users) {
+            std::lock_guard<std::mutex> guard(userLock(user->getUserId()));
+            user->display(); // Polymorphism in action
+        }
+        std::cout << std::string(80, '=') << std::endl;
+    }
+
+    // Approximate memory held by the search indices
+    size_t indexMemoryUsage() const {
+        SharedLock catalog(catalogMutex);
+        return titleIndex.memoryUsage() + authorIndex.memoryUsage() + isbnIndex.memoryUsage();
+    }
+
+    // Show search index statistics
+    void viewIndexStats() const {
+        SharedLock catalog(catalogMutex);
+        std::cout << "\n" << std::string(50, '=') << std::endl;
+        std::cout << "SEARCH INDEX STATISTICS" << std::endl;
+        std::cout << std::string(50, '=') << std::endl;
+        std::cout << std::left << std::setw(10) << "Field"
+                  << std::setw(15) << "Trigrams"
+                  << std::setw(15) << "Bytes" << std::endl;
+        std::cout << std::string(50, '-') << std::endl;
+        std::cout << std::setw(10) << "title" << std::setw(15) << titleIndex.trigramCount()
+                  << std::setw(15) << titleIndex.memoryUsage() << std::endl;
+        std::cout << std::setw(10) << "author" << std::setw(15) << authorIndex.trigramCount()
+                  << std::setw(15) << authorIndex.memoryUsage() << std::endl;
+        std::cout << std::setw(10) << "isbn" << std::setw(15) << isbnIndex.trigramCount()
+                  << std::setw(15) << isbnIndex.memoryUsage() << std::endl;
+        std::cout << std::string(50, '-') << std::endl;
+        std::cout << "Total: " << titleIndex.memoryUsage() + authorIndex.memoryUsage() + isbnIndex.memoryUsage()
+                  << " bytes" << std::endl;
+    }
+
+    // Operation counts, errors and latency percentiles, plus table and index sizes
+    std::string statsReport() {
+        std::string report;
+        char row[160];
+        report += std::string(90, '=') + "\nOPERATION STATISTICS\n" + std::string(90, '=') + "\n";
+        std::snprintf(row, sizeof(row), "%-14s%12s%10s%12s%12s%12s%12s\n",
+                      "Operation", "Count", "Errors", "p50", "p90", "p99", "Max");
+        report += row;
+        report += std::string(90, '-') + "\n";
+        for (size_t op = 0; op < OPERATION_COUNT; ++op) {
+            const OperationStats& s = stats[op];
+            auto latency = [&s](uint64_t ns) { return s.count() ? formatLatency(ns) : std::string("-"); };
+            std::snprintf(row, sizeof(row), "%-14s%12llu%10llu%12s%12s%12s%12s\n", OPERATION_NAMES[op],
+                          static_cast<unsigned long long>(s.count()), static_cast<unsigned long long>(s.errorCount()),
+                          latency(s.percentile(0.50)).c_str(), latency(s.percentile(0.90)).c_str(),
+                          latency(s.percentile(0.99)).c_str(), latency(s.maxLatency()).c_str());
+            report += row;
+        }
+
+        std::string errorRows;
+        for (size_t op = 0; op < OPERATION_COUNT; ++op) {
+            for (size_t kind = 0; kind < ERROR_KIND_COUNT; ++kind) {
+                uint64_t count = stats[op].errorCount(kind);
+                if (count == 0) continue;
+                std::snprintf(row, sizeof(row), "  %-14s%-32s%10llu\n", OPERATION_NAMES[op],
+                              kind < ERROR_KIND_COUNT - 1 ? COUNTED_ERRORS[kind] : "Other",
+                              static_cast<unsigned long long>(count));
+                errorRows += row;
+            }
+        }
+        if (!errorRows.empty()) report += "\nErrors:\n" + errorRows;
+
+        // Exclusive so the issued-count scan does not race with issue/return
+        ExclusiveLock catalog(catalogMutex);
+        report += "\nTables:\n";
+        std::snprintf(row, sizeof(row), "  Books: %zu live (%zu issued), %zu slots, %zu holes\n",
+                      books.size(), books.issuedCount(), books.slotCount(), books.holeCount());
+        report += row;
+        std::snprintf(row, sizeof(row), "  Users: %zu (%zu sparse IDs), %zu bytes pooled, %zu bytes indexed\n",
+                      users.size(), userIdToIndex.sparseSize(), userPool.memoryUsage(),
+                      userIdToIndex.memoryUsage());
+        report += row;
+        std::snprintf(row, sizeof(row), "  Versions: %llu published, %zu bytes, %zu snapshots pinned\n",
+                      static_cast<unsigned long long>(catalogVersions.epoch()), catalogVersions.memoryUsage(),
+                      catalogVersions.pinnedCount());
+        report += row;
+        std::snprintf(row, sizeof(row), "  Loans: %zu recorded, %zu open, %zu bytes\n", ledger.size(),
+                      ledger.openCount(), ledger.memoryUsage());
+        report += row;
+        std::snprintf(row, sizeof(row), "  Holds: %zu waiting on %zu books, %zu bytes\n", holds.size(),
+                      holds.bookCount(), holds.memoryUsage());
+        report += row;
+        std::snprintf(row, sizeof(row), "  Index memory: title %zu, author %zu, isbn %zu bytes\n",
+                      titleIndex.memoryUsage(), authorIndex.memoryUsage(), isbnIndex.memoryUsage());
+        report += row;
+        std::snprintf(row, sizeof(row), "  ISBN keys: %zu books, %zu bytes\n", isbnKeys.size(),
+                      isbnKeys.memoryUsage());
+        report += row;
+        std::snprintf(row, sizeof(row), "  Autocomplete: title %zu, author %zu texts, %zu bytes\n",
+                      titleCompletions.size(), authorCompletions.size(),
+                      titleCompletions.memoryUsage() + authorCompletions.memoryUsage());
+        report += row;
+        std::snprintf(row, sizeof(row), "  String pool: %zu strings, %zu bytes\n",
+                      StringPool::instance().size(), StringPool::instance().memoryUsage());
+        report += row;
+        report += "  Case-insensitive search kernel: " + std::string(CaseFoldSearch::bestKernelName()) + "\n";
+        if (journal.isOpen()) {
+            std::pair<uint64_t, uint64_t> commits = journal.commitCounts();
+            std::snprintf(row, sizeof(row), "  Journal: %zu bytes, %llu records in %llu fsyncs\n",
+                          journal.sizeBytes(), static_cast<unsigned long long>(commits.first),
+                          static_cast<unsigned long long>(commits.second));
+            report += row;
+        }
+        if (persistent) {
+            std::snprintf(row, sizeof(row),
+                          "  Background flush: every %lld ms, %llu flushes, last %s (%s locked, %llu bytes)%s\n",
+                          static_cast<long long>(getFlushInterval().count()),
+                          static_cast<unsigned long long>(flushCount.load()), formatLatency(lastFlushNs.load()).c_str(),
+                          formatLatency(lastFlushLockedNs.load()).c_str(),
+                          static_cast<unsigned long long>(lastFlushBytes.load()),
+                          checkpointFailed.load() ? ", failed" : "");
+            report += row;
+        }
+        return report;
+    }
+
+    // Print statistics, or write them to a file
+    void viewStats() {
+        std::cout << "\n" << statsReport() << std::string(90, '=') << std::endl;
+    }
+
+    bool dumpStats(const std::string& path) {
+        return writeFileAtomically(path, statsReport());
+    }
+
+    // Admin login
+    // One hash lookup, then a salted-hash verification done outside the lock.
+    // Unknown usernames are checked against a dummy hash so they take as long.
+    bool adminLogin(const std::string& username, const std::string& password) {
+        OperationTimer timer(stats[OP_ADMIN_LOGIN]);
+        static const std::string dummyHash = hashPassword("", "00000000000000000000000000000000");
+        std::string stored;
+        {
+            SharedLock catalog(catalogMutex);
+            auto it = adminsByUsername.find(username);
+            if (it != adminsByUsername.end()) stored = it->second->getPasswordHash();
+        }
+        bool known = !stored.empty();
+        if (verifyPassword(password, known ? stored : dummyHash) && known) {
+            ExclusiveLock catalog(catalogMutex);
+            // The admin may have been replaced while the password was being checked
+            auto it = adminsByUsername.find(username);
+            if (it != adminsByUsername.end() && it->second->getPasswordHash() == stored) {
+                currentAdmin = it->second;
+                return true;
+            }
+        }
+        timer.fail(ERR_INVALID_CREDENTIALS);
+        return false;
+    }
+
+    // Admin logout
+    void adminLogout() {
+        ExclusiveLock catalog(catalogMutex);
+        currentAdmin = nullptr;
+    }
+
+    // Check if admin is logged in
+    bool isAdminLoggedIn() const {
+        SharedLock catalog(catalogMutex);
+        return currentAdmin != nullptr;
+    }
+
+    // Get current admin
+    Admin* getCurrentAdmin() const {
+        SharedLock catalog(catalogMutex);
+        return currentAdmin;
+    }
+
+    // Save data to files; each file is replaced atomically
+    bool saveData() {
+        OperationTimer timer(stats[OP_SAVE_DATA]);
+        // Only what the journal made durable may reach the data files
+        if (journal.hasFailed()) rollBackUndurable();
+        try {
+            std::lock_guard<std::mutex> writing(snapshotWriteMutex);
+            std::vector<std::pair<std::string, std::string>> files;
+            uint64_t booksSeen, usersSeen, loansSeen, holdsSeen;
+            {
+                ExclusiveLock lock(catalogMutex);
+                booksSeen = booksVersion.load();
+                usersSeen = usersVersion.load();
+                loansSeen = loansVersion.load();
+                holdsSeen = holdsVersion.load();
+                files = serializeSnapshot();
+            }
+            bool ok = writeSnapshotFiles(files);
+            if (ok) {
+                booksSavedVersion = booksSeen;
+                usersSavedVersion = usersSeen;
+                loansSavedVersion = loansSeen;
+                holdsSavedVersion = holdsSeen;
+            } else {
+                timer.fail("could not write data files");
+                std::cout << "Error saving data: could not write data files" << std::endl;
+            }
+            return ok;
+        } catch (const std::exception& e) {
+            timer.fail("save failed");
+            std::cout << "Error saving data: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    // Load the snapshot, then replay any journal tail on top of it
+    void loadData() {
+        OperationTimer timer(stats[OP_LOAD_DATA]);
+        // Published once, when everything is loaded and replayed
+        CatalogVersions::WriteScope versions(catalogVersions);
+        // A damaged binary snapshot is fatal: starting empty would overwrite it on exit
+        MappedFile snapshotFile;
+        binarySnapshot = snapshotFile.open(SNAPSHOT_FILE);
+        if (binarySnapshot) {
+            loadBinarySnapshot(snapshotFile.view());
+            snapshotFile.close();
+        }
+
+        try {
+            if (!binarySnapshot) loadTextFiles();
+            versions.assign(books);
+            loadLoans();
+            loadHolds();
+            // What was just loaded is on disk already; only replayed changes need flushing
+            booksSavedVersion = booksVersion.load();
+            usersSavedVersion = usersVersion.load();
+            loansSavedVersion = loansVersion.load();
+            holdsSavedVersion = holdsVersion.load();
+
+            // A leftover checkpoint segment predates the live journal
+            auto apply = [this](std::string_view record) { replayRecord(record); };
+            size_t replayed = Journal::replay(CHECKPOINT_JOURNAL_FILE, apply);
+            size_t intactBytes = 0;
+            replayed += Journal::replay(JOURNAL_FILE, apply, &intactBytes);
+            if (replayed > 0) {
+                std::cout << "Recovered " << replayed << " journaled changes" << std::endl;
+            }
+            // Admins from a binary snapshot or the journal
+            reportShadowedAdmins();
+            // New records are appended to the live journal, so a torn tail has
+            // to go first: replay would otherwise stop there and never reach them
+            MappedFile journalFile;
+            if (journalFile.open(JOURNAL_FILE) && journalFile.view().size() > intactBytes) {
+                size_t dropped = journalFile.view().size() - intactBytes;
+                journalFile.close();
+                std::cout << "Dropping " << dropped << " bytes of damaged journal after the last intact record"
+                          << std::endl;
+                // Failing that, fold what was replayed into a snapshot and start an empty journal
+                if (!truncateFile(JOURNAL_FILE, intactBytes) &&
+                    !(saveData() && std::remove(JOURNAL_FILE.c_str()) == 0)) {
+                    journalDamaged = true;
+                    checkpointFailed.store(true);
+                    std::cout << "Error: cannot truncate " << JOURNAL_FILE << ", changes are saved on exit only"
+                              << std::endl;
+                }
+            }
+            reconcileLoans();
+            reconcileHolds();
+            // Finish the interrupted checkpoint so the next rotation has a free slot
+            std::FILE* stale = std::fopen(CHECKPOINT_JOURNAL_FILE.c_str(), "rb");
+            if (stale) {
+                std::fclose(stale);
+                if (saveData()) std::remove(CHECKPOINT_JOURNAL_FILE.c_str());
+            }
+        } catch (const std::exception& e) {
+            timer.fail("load failed");
+            std::cout << "Error loading data: " << e.what() << std::endl;
+        }
+    }
+
+    // Bulk-load a binary snapshot image: fixed-width records, no field parsing
+    void loadBinarySnapshot(std::string_view image) {
+        BinarySnapshot snapshot;
+        std::string error;
+        if (!snapshot.open(image, error)) {
+            throw std::runtime_error(SNAPSHOT_FILE + ": " + error);
+        }
+
+        books.reserve(books.slotCount() + snapshot.bookCount());
+        bookIdToIndex.reserve(bookIdToIndex.size() + snapshot.bookCount());
+        isbnKeys.reserve(isbnKeys.size() + snapshot.bookCount());
+        size_t duplicates = 0;
+        beginBulkIndexing();
+        for (size_t i = 0; i < snapshot.bookCount(); ++i) {
+            Book book = snapshot.book(i);
+            int id = book.getBookId();
+            reportDuplicateIsbn(book, duplicates);
+            indexBook(book);
+            bookIdToIndex[id] = books.insert(std::move(book));
+            if (id >= nextBookId) nextBookId = id + 1;
+        }
+        endBulkIndexing();
+        reportDuplicateIsbnTotal(SNAPSHOT_FILE, duplicates);
+
+        users.reserve(users.size() + snapshot.userCount());
+        userIdToIndex.reserve(users.size() + snapshot.userCount());
+        for (size_t i = 0; i < snapshot.userCount(); ++i) {
+            User* user = snapshot.user(i, userPool);
+            // Skip the default admin, which the constructor already created
+            if (user->getUserId() == 0) {
+                userPool.destroy(user);
+                continue;
+            }
+            applyPutUser(user);
+        }
+    }
+
+    // Load the loan ledger written with the last snapshot
+    void loadLoans() {
+        MappedFile loansFile;
+        if (!loansFile.open(LOANS_FILE)) return;
+        size_t malformed = 0;
+        forEachLine(loansFile.view(), [&](size_t lineNumber, std::string_view line) {
+            Loan loan;
+            if (!loan.fromFileString(line) || !ledger.insert(loan)) {
+                reportMalformedLine(LOANS_FILE, lineNumber, malformed);
+            }
+        });
+        reportMalformedTotal(LOANS_FILE, malformed);
+    }
+
+    // Load the hold queues written with the last snapshot, in line order
+    void loadHolds() {
+        MappedFile holdsFile;
+        if (!holdsFile.open(HOLDS_FILE)) return;
+        size_t malformed = 0;
+        forEachLine(holdsFile.view(), [&](size_t lineNumber, std::string_view line) {
+            Hold hold;
+            if (!hold.fromFileString(line) || !holds.insert(hold)) {
+                reportMalformedLine(HOLDS_FILE, lineNumber, malformed);
+            }
+        });
+        reportMalformedTotal(HOLDS_FILE, malformed);
+    }
+
+    // Drop holds on books or by users that no longer exist, or by the current
+    // borrower, and hand any book that is not on loan to the first in line
+    // (only seen in hand-edited data; a return and its handoff are journaled together)
+    void reconcileHolds() {
+        size_t handedOver = 0;
+        for (int bookId : holds.booksWithHolds()) {
+            auto bookIt = bookIdToIndex.find(bookId);
+            for (const Hold& hold : holds.queueFor(bookId)) {
+                if (bookIt == bookIdToIndex.end() || userIdToIndex.find(hold.userId) < 0) {
+                    applyEndHold(hold.holdId);
+                } else if (!books.isIssued(bookIt->second)) {
+                    applyEndHold(hold.holdId);
+                    applyIssue(bookId, hold.userId);
+                    int64_t now = currentTime();
+                    ledger.open(bookId, hold.userId, now, now + LOAN_PERIOD_SECONDS);
+                    loansVersion.fetch_add(1, std::memory_order_relaxed);
+                    ++handedOver;
+                } else if (books.issuedToUserId(bookIt->second) == hold.userId) {
+                    applyEndHold(hold.holdId);
+                }
+            }
+        }
+        if (handedOver > 0) {
+            std::cout << "Issued " << handedOver << " returned books to the patrons waiting for them" << std::endl;
+        }
+    }
+
+    // The book table is authoritative for who holds what. Open loans that no
+    // longer match it are closed, and issued books without an open loan (data
+    // from before the ledger existed) get one due a loan period from now.
+    void reconcileLoans() {
+        int64_t now = currentTime();
+        std::vector<int> stale;
+        ledger.forEachOpen([&](const Loan& loan) {
+            auto it = bookIdToIndex.find(loan.bookId);
+            if (it == bookIdToIndex.end() || !books.isIssued(it->second) ||
+                books.issuedToUserId(it->second) != loan.userId) {
+                stale.push_back(loan.loanId);
+            }
+        });
+        for (int loanId : stale) applyLoanReturn(loanId, now);
+
+        size_t adopted = 0;
+        Loan open;
+        for (auto it = books.begin(); it != books.end(); ++it) {
+            size_t slot = it.index();
+            if (!books.isIssued(slot) || ledger.openLoanFor(books.bookId(slot), open)) continue;
+            ledger.open(books.bookId(slot), books.issuedToUserId(slot), 0, now + LOAN_PERIOD_SECONDS);
+            ++adopted;
+        }
+        if (adopted > 0) {
+            loansVersion.fetch_add(1, std::memory_order_relaxed);
+            std::cout << "Started loan records for " << adopted << " books already on loan, due "
+                      << formatDate(now + LOAN_PERIOD_SECONDS) << std::endl;
+        }
+    }
+
+    // Rows parsed from one newline-aligned piece of books.txt or users.txt
+    struct BookPiece {
+        std::vector<Book> books;
+        std::vector<size_t> malformedLines;  // numbered from the start of the piece
+        size_t lineCount = 0;
+        int maxBookId = 0;
+    };
+
+    struct UserPiece {
+        UserPool pool;  // owns `users` until merged into userPool
+        std::vector<User*> users;
+        std::vector<size_t> malformedLines;
+        size_t lineCount = 0;
+    };
+
+    static void parseBookPiece(std::string_view text, BookPiece& piece) {
+        piece.lineCount = std::count(text.begin(), text.end(), '\n');
+        piece.books.reserve(piece.lineCount + 1);
+        forEachLine(text, [&](size_t lineNumber, std::string_view line) {
+            Book book;
+            if (!book.fromFileString(line)) {
+                piece.malformedLines.push_back(lineNumber);
+                return;
+            }
+            piece.maxBookId = std::max(piece.maxBookId, book.getBookId());
+            piece.books.push_back(std::move(book));
+        });
+    }
+
+    static void parseUserPiece(std::string_view text, UserPiece& piece) {
+        piece.lineCount = std::count(text.begin(), text.end(), '\n');
+        piece.users.reserve(piece.lineCount + 1);
+        forEachLine(text, [&](size_t lineNumber, std::string_view line) {
+            User* user = parseUserRow(line, piece.pool);
+            if (user) {
+                piece.users.push_back(user);
+            } else {
+                piece.malformedLines.push_back(lineNumber);
+            }
+        });
+    }
+
+    // Files at most this large are parsed as a single piece
+    static constexpr size_t LOAD_PIECE_BYTES = 1 << 20;
+
+    // Map books.txt and users.txt and load them together on a thread pool.
+    // Both files are cut into newline-aligned pieces that are parsed in
+    // parallel; then every table and index is built by one task walking the
+    // pieces in file order, so the result is the same for any thread count.
+    void loadTextFiles() {
+        MappedFile booksFile, usersFile;
+        std::string_view booksText = booksFile.open(BOOKS_FILE) ? booksFile.view() : std::string_view();
+        std::string_view usersText = usersFile.open(USERS_FILE) ? usersFile.view() : std::string_view();
+        if (booksText.empty() && usersText.empty()) return;
+
+        size_t threads = loadThreads ? loadThreads : std::max(1u, std::thread::hardware_concurrency());
+        auto piecesFor = [threads](std::string_view text) {
+            return splitAtLines(text, std::min(threads * 4, text.size() / LOAD_PIECE_BYTES + 1));
+        };
+        std::vector<std::string_view> bookTexts = piecesFor(booksText);
+        std::vector<std::string_view> userTexts = piecesFor(usersText);
+        std::vector<BookPiece> bookPieces(bookTexts.size());
+        std::vector<UserPiece> userPieces(userTexts.size());
+        // Declared last so it is joined before the pieces it works on go away
+        ThreadPool pool(threads);
+
+        std::vector<std::future<void>> parsed;
+        for (size_t i = 0; i < bookTexts.size(); ++i) {
+            parsed.push_back(pool.submit([&, i] { parseBookPiece(bookTexts[i], bookPieces[i]); }));
+        }
+        for (size_t i = 0; i < userTexts.size(); ++i) {
+            parsed.push_back(pool.submit([&, i] { parseUserPiece(userTexts[i], userPieces[i]); }));
+        }
+        for (auto& done : parsed) done.get();
+
+        size_t bookCount = 0, userCount = 0;
+        for (const BookPiece& piece : bookPieces) {
+            bookCount += piece.books.size();
+            nextBookId = std::max(nextBookId, piece.maxBookId + 1);
+        }
+        for (const UserPiece& piece : userPieces) userCount += piece.users.size();
+        reportMalformedPieces(BOOKS_FILE, bookPieces);
+
+        auto forEachBook = [&bookPieces](auto fn) {
+            for (const BookPiece& piece : bookPieces) {
+                for (const Book& book : piece.books) fn(book);
+            }
+        };
+        auto buildCompletions = [&forEachBook](PrefixIndex& index, InternedString (Book::*field)() const) {
+            index.beginBulkLoad();
+            forEachBook([&](const Book& book) { index.insert((book.*field)()); });
+            index.endBulkLoad();
+        };
+
+        // Only the ISBN task prints (duplicate warnings) until everything is joined
+        size_t duplicates = 0;
+        std::vector<std::future<void>> built;
+        built.push_back(pool.submit([&] {
+            forEachBook([&](const Book& book) { titleIndex.insert(book.getBookId(), book.getTitle()); });
+        }));
+        built.push_back(pool.submit([&] {
+            forEachBook([&](const Book& book) { authorIndex.insert(book.getBookId(), book.getAuthor()); });
+        }));
+        built.push_back(pool.submit([&] {
+            forEachBook([&](const Book& book) { isbnIndex.insert(book.getBookId(), book.getIsbn()); });
+        }));
+        built.push_back(pool.submit([&] { buildCompletions(titleCompletions, &Book::getTitleHandle); }));
+        built.push_back(pool.submit([&] { buildCompletions(authorCompletions, &Book::getAuthorHandle); }));
+        built.push_back(pool.submit([&] {
+            isbnKeys.reserve(isbnKeys.size() + bookCount);
+            forEachBook([&](const Book& book) {
+                reportDuplicateIsbn(book, duplicates);
+                if (uint64_t key = isbnKey(book.getIsbn())) isbnKeys.insert(key, book.getBookId());
+            });
+        }));
+        built.push_back(pool.submit([&] {
+            users.reserve(users.size() + userCount);
+            userIdToIndex.reserve(users.size() + userCount);
+            for (UserPiece& piece : userPieces) {
+                userPool.absorb(piece.pool);
+                for (User* user : piece.users) {
+                    // Don't add if it's the default admin
+                    if (user->getUserId() == 0) {
+                        userPool.destroy(user);
+                    } else {
+                        applyPutUser(user);
+                    }
+                }
+                piece.users.clear();
+            }
+        }));
+
+        // The book store itself is filled on this thread meanwhile
+        books.reserve(books.slotCount() + bookCount);
+        bookIdToIndex.reserve(bookIdToIndex.size() + bookCount);
+        forEachBook([&](const Book& book) { bookIdToIndex[book.getBookId()] = books.insert(book); });
+
+        for (auto& done : built) done.get();
+        reportDuplicateIsbnTotal(BOOKS_FILE, duplicates);
+        reportMalformedPieces(USERS_FILE, userPieces);
+        reportShadowedAdmins();
+    }
+
+    // Print the admins applyPutUser found sharing a username, then forget them
+    void reportShadowedAdmins() {
+        for (const ShadowedAdmin& shadowed : shadowedAdmins) {
+            std::cout << "Warning: admin " << shadowed.userId << " has the same username as admin "
+                      << shadowed.firstUserId << " (" << shadowed.username << "), only the first can log in"
+                      << std::endl;
+        }
+        shadowedAdmins.clear();
+    }
+
+    // Report malformed lines of a file loaded in pieces, numbered from the top of the file
+    template <typename Piece>
+    static void reportMalformedPieces(const std::string& fileName, const std::vector<Piece>& pieces) {
+        size_t malformed = 0;
+        size_t firstLine = 0;
+        for (const Piece& piece : pieces) {
+            for (size_t line : piece.malformedLines) reportMalformedLine(fileName, firstLine + line, malformed);
+            firstLine += piece.lineCount;
+        }
+        reportMalformedTotal(fileName, malformed);
+    }
+
+    // Report the first few malformed lines individually, then just count them
+    static void reportMalformedLine(const std::string& fileName, size_t lineNumber, size_t& malformed) {
+        if (malformed < MAX_REPORTED_MALFORMED) {
+            std::cout << "Skipping malformed line " << lineNumber << " in " << fileName << std::endl;
+        }
+        ++malformed;
+    }
+
+    static void reportMalformedTotal(const std::string& fileName, size_t malformed) {
+        if (malformed > MAX_REPORTED_MALFORMED) {
+            std::cout << "Skipped " << malformed << " malformed lines in " << fileName << std::endl;
+        }
+    }
+
+    // Loaded data is kept as is, but books sharing an ISBN are pointed out
+    void reportDuplicateIsbn(const Book& book, size_t& duplicates) const {
+        int other = bookWithIsbn(book.getIsbn(), book.getBookId());
+        if (other < 0) return;
+        if (duplicates < MAX_REPORTED_MALFORMED) {
+            std::cout << "Warning: book " << book.getBookId() << " has the same ISBN as book " << other << " ("
+                      << book.getIsbn() << ")" << std::endl;
+        }
+        ++duplicates;
+    }
+
+    static void reportDuplicateIsbnTotal(const std::string& fileName, size_t duplicates) {
+        if (duplicates > MAX_REPORTED_MALFORMED) {
+            std::cout << "Found " << duplicates << " books with duplicate ISBNs in " << fileName << std::endl;
+        }
+    }
+
+    // Batch mode: apply commands from a file ("-" for stdin), one per line:
+    //   ADD_BOOK title|author|isbn        UPDATE_BOOK id title|author|isbn
+    //   DELETE_BOOK id                    ISSUE bookId userId
+    //   RETURN bookId                     ADD_USER name|email
+    //   ADD_ADMIN name|email|username|password
+    //   HOLD bookId userId                CANCEL_HOLD holdId
+    //   BEGIN, COMMIT, ABORT: ISSUE/RETURN/ADD_BOOK/ADD_USER lines in between
+    //   are applied all-or-nothing as one transaction
+    // Blank lines and lines starting with '#' are ignored. Only failures are
+    // reported per line; a summary with throughput is printed at the end.
+    bool runBatch(const std::string& source) {
+        BatchRun batch;
+        auto started = std::chrono::steady_clock::now();
+
+        // Journal records are group-committed once at the end instead of per command
+        bool savedSyncCommit = syncCommit;
+        syncCommit = false;
+
+        if (source == "-") {
+            std::ios::sync_with_stdio(false);
+            std::string line;
+            size_t lineNumber = 0;
+            while (std::getline(std::cin, line)) {
+                ++lineNumber;
+                std::string_view view(line);
+                if (!view.empty() && view.back() == '\r') view.remove_suffix(1);
+                if (!view.empty()) executeBatchLine(batch, lineNumber, view);
+            }
+        } else {
+            MappedFile file;
+            if (!file.open(source)) {
+                syncCommit = savedSyncCommit;
+                std::cout << "Cannot open batch file " << source << std::endl;
+                return false;
+            }
+            forEachLine(file.view(), [&](size_t lineNumber, std::string_view line) {
+                executeBatchLine(batch, lineNumber, line);
+            });
+        }
+
+        if (batch.inTransaction) {
+            for (const Transaction::Op& op : batch.txn.ops()) ++batch.counters[op.command].failed;
+            batch.output += "Transaction without COMMIT at end of input, nothing applied\n";
+        }
+        bool durable = syncJournal();
+        syncCommit = savedSyncCommit;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        size_t total = 0, failed = 0;
+        char row[128];
+        batch.output += "\nBatch Summary:\n";
+        batch.output += std::string(50, '-') + "\n";
+        std::snprintf(row, sizeof(row), "%-15s%12s%12s\n", "Command", "Succeeded", "Failed");
+        batch.output += row;
+        batch.output += std::string(50, '-') + "\n";
+        for (size_t i = 0; i < COMMAND_COUNT; ++i) {
+            const BatchCounter& c = batch.counters[i];
+            if (c.ok == 0 && c.failed == 0) continue;
+            std::snprintf(row, sizeof(row), "%-15s%12zu%12zu\n", COMMAND_NAMES[i], c.ok, c.failed);
+            batch.output += row;
+            total += c.ok + c.failed;
+            failed += c.failed;
+        }
+        batch.output += std::string(50, '-') + "\n";
+        std::snprintf(row, sizeof(row), "%zu commands (%zu failed) in %.3f s, %.0f commands/s\n",
+                      total, failed, seconds, seconds > 0 ? total / seconds : 0.0);
+        batch.output += row;
+        if (!durable) batch.output += "Warning: journal sync failed, changes not yet durable were rolled back\n";
+        flushBatchOutput(batch, true);
+        return durable;
+    }
+
+    // Get input with validation
+    int getValidatedInput(int min, int max) {
+        int choice;
+        while (true) {
+            std::cout << "Enter your choice (" << min << "-" << max << "): ";
+            if (std::cin >> choice) {
+                if (choice >= min && choice <= max) {
+                    return choice;
+                } else {
+                    std::cout << "Invalid choice! Please enter a number between " << min << " and " << max << "." << std::endl;
+                }
+            } else {
+                std::cout << "Invalid input! Please enter a valid number." << std::endl;
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+        }
+    }
+
+    // Main menu
+    void showMainMenu() {
+        std::cout << "\n" << std::string(50, '=') << std::endl;
+        std::cout << "    LIBRARY MANAGEMENT SYSTEM" << std::endl;
+        std::cout << std::string(50, '=') << std::endl;
+        std::cout << "1. Admin Login" << std::endl;
+        std::cout << "2. View Available Books" << std::endl;
+        std::cout << "3. Search Books" << std::endl;
+        std::cout << "4. Exit" << std::endl;
+        std::cout << std::string(50, '=') << std::endl;
+    }
+
+    // Admin menu
+    void showAdminMenu() {
+        std::cout << "\n" << std::string(50, '=') << std::endl;
+        std::cout << "    ADMIN PANEL" << std::endl;
+        std::cout << "    Welcome, " << getCurrentAdmin()->getName() << "!" << std::endl;
+        std::cout << std::string(50, '=') << std::endl;
+        std::cout << "1. Add Book" << std::endl;
+        std::cout << "2. View All Books" << std::endl;
+        std::cout << "3. Update Book" << std::endl;
+        std::cout << "4. Delete Book" << std::endl;
+        std::cout << "5. Issue Book" << std::endl;
+        std::cout << "6. Return Book" << std::endl;
+        std::cout << "7. Add User" << std::endl;
+        std::cout << "8. View All Users" << std::endl;
+        std::cout << "9. Search Books" << std::endl;
+        std::cout << "10. Index Statistics" << std::endl;
+        std::cout << "11. Operation Statistics" << std::endl;
+        std::cout << "12. Dump Statistics to File" << std::endl;
+        std::cout << "13. Overdue Loans" << std::endl;
+        std::cout << "14. Place Hold" << std::endl;
+        std::cout << "15. Cancel Hold" << std::endl;
+        std::cout << "16. Logout" << std::endl;
+        std::cout << std::string(50, '=') << std::endl;
+    }
+
+    // Run the system
+    void run() {
+        std::cout << "Welcome to the Library Management System!" << std::endl;
+        
+        while (true) {
+            try {
+                if (!isAdminLoggedIn()) {
+                    showMainMenu();
+                    int choice = getValidatedInput(1, 4);
+
+                    switch (choice) {
+                        case 1: {
+                            std::string username, password;
+                            std::cout << "Enter username: ";
+                            std::cin >> username;
+                            std::cout << "Enter password: ";
                             std::cin >> password;
 
                             if (adminLogin(username, password)) {
                                 std::cout << "Login successful!" << std::endl;
                             } else {
-                                std::cout << "Invalid credentials!" << std::endl;
+                                std::cout << ERR_INVALID_CREDENTIALS << std::endl;
                             }
                             break;
                         }
@@ -743,13 +6624,23 @@ public:
                             viewBooks();
                             break;
                         case 3: {
-                            std::string query, searchType;
-                            std::cout << "Search by (title/author/isbn): ";
+                            std::string query, searchType, answer;
+                            std::cout << "Search by (title/author/isbn/any/fuzzy): ";
                             std::cin >> searchType;
                             std::cout << "Enter search query: ";
                             std::cin.ignore();
                             std::getline(std::cin, query);
-                            searchBooks(query, searchType);
+                            if (searchType == "any") {
+                                browseRankedSearch(query);
+                                break;
+                            }
+                            if (searchType == "fuzzy") {
+                                fuzzySearchBooks(query);
+                                break;
+                            }
+                            std::cout << "Ignore case? (y/n): ";
+                            std::cin >> answer;
+                            searchBooks(query, searchType, answer == "y" || answer == "Y");
                             break;
                         }
                         case 4:
@@ -758,7 +6649,7 @@ public:
                     }
                 } else {
                     showAdminMenu();
-                    int choice = getValidatedInput(1, 10);
+                    int choice = getValidatedInput(1, 16);
 
                     switch (choice) {
                         case 1: {
@@ -825,38 +6716,1622 @@ public:
                                 std::cout << "Enter password: ";
                                 std::cin >> password;
                             }
-                            
-                            addUser(name, email, isAdmin, username, password);
-                            break;
+                            
+                            addUser(name, email, isAdmin, username, password);
+                            break;
+                        }
+                        case 8:
+                            viewUsers();
+                            break;
+                        case 9: {
+                            std::string query, searchType, answer;
+                            std::cout << "Search by (title/author/isbn/any/fuzzy): ";
+                            std::cin >> searchType;
+                            std::cout << "Enter search query: ";
+                            std::cin.ignore();
+                            std::getline(std::cin, query);
+                            if (searchType == "any") {
+                                browseRankedSearch(query);
+                                break;
+                            }
+                            if (searchType == "fuzzy") {
+                                fuzzySearchBooks(query);
+                                break;
+                            }
+                            std::cout << "Ignore case? (y/n): ";
+                            std::cin >> answer;
+                            searchBooks(query, searchType, answer == "y" || answer == "Y");
+                            break;
+                        }
+                        case 10:
+                            viewIndexStats();
+                            break;
+                        case 11:
+                            viewStats();
+                            break;
+                        case 12: {
+                            std::string path;
+                            std::cout << "Enter file name: ";
+                            std::cin >> path;
+                            if (dumpStats(path)) {
+                                std::cout << "Statistics written to " << path << std::endl;
+                            } else {
+                                std::cout << "Error writing statistics to " << path << std::endl;
+                            }
+                            break;
+                        }
+                        case 13:
+                            viewOverdueLoans();
+                            break;
+                        case 14: {
+                            int bookId, userId;
+                            std::cout << "Enter book ID: ";
+                            std::cin >> bookId;
+                            std::cout << "Enter user ID: ";
+                            std::cin >> userId;
+                            placeHold(bookId, userId);
+                            break;
+                        }
+                        case 15: {
+                            int holdId;
+                            std::cout << "Enter hold ID to cancel: ";
+                            std::cin >> holdId;
+                            cancelHold(holdId);
+                            break;
+                        }
+                        case 16:
+                            adminLogout();
+                            std::cout << "Logged out successfully!" << std::endl;
+                            break;
+                    }
+                }
+            } catch (const std::exception& e) {
+                std::cout << "An error occurred: " << e.what() << std::endl;
+            }
+        }
+    }
+};
+
+// Concurrency stress test: a mixed issue/return/search workload on an in-memory
+// catalog, run on worker pools of increasing size to show throughput scaling.
+// After each run the issued count must equal successful issues minus returns
+// and the tables must agree with each other; false if either check fails.
+bool runStressTest(size_t maxThreads) {
+    const int BOOK_COUNT = 100000;
+    const int USER_COUNT = 10000;
+    const size_t OPS_PER_RUN = 2000000;
+
+    LibrarySystem library(false);
+    for (int i = 1; i <= BOOK_COUNT; ++i) {
+        library.addBookOp("Title " + std::to_string(i), "Author " + std::to_string(i % 997),
+                          "isbn-" + std::to_string(i));
+    }
+    for (int i = 1; i <= USER_COUNT; ++i) {
+        library.addUserOp("User " + std::to_string(i), "user" + std::to_string(i) + "@library.com");
+    }
+
+    std::cout << "Stress test: " << OPS_PER_RUN << " operations on " << BOOK_COUNT << " books, "
+              << USER_COUNT << " users (" << std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+    std::cout << std::left << std::setw(10) << "Threads" << std::setw(15) << "Ops/s"
+              << std::setw(10) << "Speedup" << std::endl;
+    std::cout << std::string(35, '-') << std::endl;
+
+    double baseline = 0;
+    long long expectedIssued = 0;
+    std::string problem;
+    for (size_t threads = 1; threads <= maxThreads && problem.empty(); threads *= 2) {
+        library.setWorkerThreads(threads);
+        size_t perTask = OPS_PER_RUN / threads;
+        std::vector<std::future<void>> done;
+        std::atomic<long long> issues(0), returns(0);
+
+        auto started = std::chrono::steady_clock::now();
+        for (size_t t = 0; t < threads; ++t) {
+            done.push_back(library.submit([&library, &issues, &returns, perTask, t]() {
+                std::mt19937 rng(static_cast<unsigned>(t + 1));
+                std::uniform_int_distribution<int> bookDist(1, BOOK_COUNT);
+                std::uniform_int_distribution<int> userDist(1, USER_COUNT);
+                for (size_t i = 0; i < perTask; ++i) {
+                    int bookId = bookDist(rng);
+                    unsigned kind = rng() % 100;
+                    if (kind < 45) {
+                        if (library.issueBookOp(bookId, userDist(rng)).ok) ++issues;
+                    } else if (kind < 90) {
+                        if (library.returnBookOp(bookId).ok) ++returns;
+                    } else {
+                        library.searchBookIds("Title " + std::to_string(bookId), "title");
+                    }
+                }
+            }));
+        }
+        for (auto& f : done) f.get();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        double opsPerSecond = (perTask * threads) / seconds;
+        if (threads == 1) baseline = opsPerSecond;
+        std::cout << std::setw(10) << threads << std::setw(15) << static_cast<long long>(opsPerSecond)
+                  << std::fixed << std::setprecision(2) << opsPerSecond / baseline << "x" << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+
+        expectedIssued += issues - returns;
+        size_t issued = library.bookCounts().second;
+        if (static_cast<long long>(issued) != expectedIssued) {
+            problem = std::to_string(issued) + " books issued, expected " + std::to_string(expectedIssued);
+        } else {
+            problem = library.checkConsistency();
+        }
+    }
+    if (!problem.empty()) {
+        std::cout << "Inconsistent after the run: " << problem << std::endl;
+        return false;
+    }
+    std::cout << "Tables consistent after every run" << std::endl;
+    return true;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+// Seeded generator of synthetic catalogs with realistic field lengths
+class CatalogGenerator {
+private:
+    std::mt19937 rng;
+    std::vector<std::string> authors;
+
+    // Pronounceable capitalised word of 1-4 syllables
+    std::string word() {
+        static const char consonants[] = "bcdfghklmnprstvwz";
+        static const char vowels[] = "aeiou";
+        std::string result;
+        size_t syllables = 1 + rng() % 4;
+        for (size_t i = 0; i < syllables; ++i) {
+            result += consonants[rng() % (sizeof(consonants) - 1)];
+            result += vowels[rng() % (sizeof(vowels) - 1)];
+            if (rng() % 3 == 0) result += consonants[rng() % (sizeof(consonants) - 1)];
+        }
+        result[0] = static_cast<char>(std::toupper(static_cast<unsigned char>(result[0])));
+        return result;
+    }
+
+public:
+    // Titles share a pool of one author per ~10 books
+    CatalogGenerator(unsigned seed, size_t bookCount) : rng(seed) {
+        size_t authorCount = std::max<size_t>(1, bookCount / 10);
+        authors.reserve(authorCount);
+        for (size_t i = 0; i < authorCount; ++i) {
+            authors.push_back(rng() % 5 == 0 ? word() + " " + word().substr(0, 1) + ". " + word()
+                                             : word() + " " + word());
+        }
+    }
+
+    // 1-8 words, most titles have 2-4
+    std::string title() {
+        static const double weights[] = {10, 25, 25, 18, 10, 6, 4, 2};
+        std::discrete_distribution<size_t> wordCount(std::begin(weights), std::end(weights));
+        size_t count = wordCount(rng) + 1;
+        std::string result = word();
+        for (size_t i = 1; i < count; ++i) result += " " + word();
+        return result;
+    }
+
+    const std::string& author() { return authors[rng() % authors.size()]; }
+
+    // Unique, valid ISBN-13 for each serial number
+    static std::string isbn(int serial) {
+        char digits[14];
+        std::snprintf(digits, sizeof(digits), "978%09u",
+                      static_cast<unsigned>((static_cast<uint64_t>(serial) * 7919u) % 1000000000u));
+        int sum = 0;
+        for (int i = 0; i < 12; ++i) sum += (digits[i] - '0') * (i % 2 ? 3 : 1);
+        digits[12] = static_cast<char>('0' + (10 - sum % 10) % 10);
+        digits[13] = '\0';
+        return digits;
+    }
+
+    std::string userName() { return word() + " " + word(); }
+
+    int uniform(int low, int high) { return std::uniform_int_distribution<int>(low, high)(rng); }
+
+    // Skewed towards low values, so a few users hold many loans
+    int skewed(int count) {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return std::min(count - 1, static_cast<int>(count * u * u));
+    }
+};
+
+// Peak resident set size of this process in KB
+static long peakRssKb() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+// Time fn(i) for i in [0, iterations) and print one CSV result row
+template <typename Fn>
+static void runBenchmark(const char* name, size_t iterations, Fn fn) {
+    auto started = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) fn(i);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count();
+    double nsPerOp = iterations ? ns / iterations : 0;
+    std::printf("%s,%zu,%.1f,%.0f,%ld\n", name, iterations, nsPerOp, nsPerOp > 0 ? 1e9 / nsPerOp : 0,
+                peakRssKb());
+    std::fflush(stdout);
+}
+
+// Benchmarks that save and load work in a fresh temporary directory, since
+// the data files have fixed names. Leaving it (at the latest on destruction)
+// removes the library's files and the directory and returns to the previous
+// working directory.
+class ScratchDirectory {
+private:
+    char path[32];
+    char previous[4096];
+    bool created;
+    bool entered;
+
+public:
+    ScratchDirectory() : path("/tmp/library-bench-XXXXXX"), previous(), created(false), entered(false) {
+        created = getcwd(previous, sizeof(previous)) && mkdtemp(path);
+        entered = created && chdir(path) == 0;
+        if (!entered) std::printf("Cannot create a scratch directory for the benchmark\n");
+    }
+    ScratchDirectory(const ScratchDirectory&) = delete;
+    ScratchDirectory& operator=(const ScratchDirectory&) = delete;
+
+    ~ScratchDirectory() { leave(); }
+
+    bool ok() const { return entered; }
+
+    // False if the previous working directory could not be restored
+    bool leave() {
+        bool restored = true;
+        if (entered) {
+            for (const char* file : {"books.txt", "users.txt", "loans.txt", "holds.txt", "library.snap",
+                                     "library.journal", "library.journal.old"}) {
+                std::remove(file);
+            }
+            restored = chdir(previous) == 0;
+            entered = false;
+        }
+        if (created) {
+            rmdir(path);
+            created = false;
+        }
+        return restored;
+    }
+};
+
+// Repeatable microbenchmarks of the core operations on a synthetic catalog.
+// Output is CSV (name,iterations,ns_per_op,ops_per_s,peak_rss_kb) for diffing.
+bool runBenchmarks(size_t bookCount, size_t userCount, unsigned seed) {
+    const size_t SEARCH_QUERIES = 20000;
+    const size_t SCANS = 50;
+    const size_t MUTATIONS = 50000;
+    const size_t SAVE_LOAD_ROUNDS = 3;
+
+    ScratchDirectory scratch;
+    if (!scratch.ok()) return false;
+
+    CatalogGenerator generator(seed, bookCount);
+    std::vector<std::string> titles(bookCount), authors(bookCount);
+    for (size_t i = 0; i < bookCount; ++i) {
+        titles[i] = generator.title();
+        authors[i] = generator.author();
+    }
+
+    std::printf("# books=%zu users=%zu seed=%u\n", bookCount, userCount, seed);
+    std::printf("benchmark,iterations,ns_per_op,ops_per_s,peak_rss_kb\n");
+    {
+        LibrarySystem library(false);
+        runBenchmark("add_book", bookCount, [&](size_t i) {
+            library.addBookOp(titles[i], authors[i], CatalogGenerator::isbn(static_cast<int>(i + 1)));
+        });
+
+        // Users with loan histories: closed loans for half the catalog's worth
+        // of past checkouts, then a quarter of the catalog on loan
+        for (size_t i = 0; i < userCount; ++i) {
+            library.addUserOp(generator.userName(), "user" + std::to_string(i + 1) + "@library.com");
+        }
+        for (size_t i = 0; i < bookCount / 2; ++i) {
+            int bookId = generator.uniform(1, static_cast<int>(bookCount));
+            if (library.issueBookOp(bookId, generator.skewed(static_cast<int>(userCount)) + 1).ok) {
+                library.returnBookOp(bookId);
+            }
+        }
+        std::vector<char> onLoan(bookCount + 1, 0);
+        for (size_t i = 0; i < bookCount / 4; ++i) {
+            int bookId = generator.uniform(1, static_cast<int>(bookCount));
+            if (library.issueBookOp(bookId, generator.skewed(static_cast<int>(userCount)) + 1).ok) {
+                onLoan[bookId] = 1;
+            }
+        }
+
+        std::vector<int> picks(SEARCH_QUERIES);
+        for (auto& pick : picks) pick = generator.uniform(1, static_cast<int>(bookCount));
+        runBenchmark("search_title_hit", SEARCH_QUERIES, [&](size_t i) {
+            library.searchBookIds(titles[picks[i] - 1], "title");
+        });
+        runBenchmark("search_title_miss", SEARCH_QUERIES, [&](size_t i) {
+            library.searchBookIds("Qxq " + std::to_string(picks[i]), "title");
+        });
+        runBenchmark("search_author_hit", SEARCH_QUERIES, [&](size_t i) {
+            library.searchBookIds(authors[picks[i] - 1], "author");
+        });
+        runBenchmark("search_author_miss", SEARCH_QUERIES, [&](size_t i) {
+            library.searchBookIds("Qxq " + std::to_string(picks[i]), "author");
+        });
+        runBenchmark("search_isbn_hit", SEARCH_QUERIES, [&](size_t i) {
+            library.searchBookIds(CatalogGenerator::isbn(picks[i]), "isbn");
+        });
+        runBenchmark("search_isbn_miss", SEARCH_QUERIES, [&](size_t i) {
+            library.searchBookIds("979" + std::to_string(picks[i]), "isbn");
+        });
+        runBenchmark("search_isbn_partial", SEARCH_QUERIES, [&](size_t i) {
+            library.searchBookIds(CatalogGenerator::isbn(picks[i]).substr(3, 9), "isbn");
+        });
+        runBenchmark("lookup_isbn", SEARCH_QUERIES, [&](size_t i) {
+            library.findBookByIsbn(CatalogGenerator::isbn(picks[i]));
+        });
+
+        // Two-letter queries are below the trigram minimum and scan a whole column
+        runBenchmark("scan_title", SCANS, [&](size_t i) {
+            library.searchBookIds(titles[picks[i] - 1].substr(0, 2), "title");
+        });
+        // A one-letter query copies the whole matching catalog; the ranked search keeps ten hits
+        runBenchmark("search_one_letter_all", SCANS, [&](size_t i) {
+            library.findBooks(titles[picks[i] - 1].substr(0, 1), "title");
+        });
+        runBenchmark("ranked_one_letter_top10", SCANS, [&](size_t i) {
+            library.rankedSearch(titles[picks[i] - 1].substr(0, 1), 10);
+        });
+        runBenchmark("ranked_word_top10", SEARCH_QUERIES, [&](size_t i) {
+            const std::string& title = titles[picks[i] - 1];
+            library.rankedSearch(title.substr(0, title.find(' ')), 10);
+        });
+        // Type-ahead replay: every prefix of a title or author, as a desk terminal sends
+        // them while the patron types, against the old search-per-keystroke approach
+        const size_t TYPED_NAMES = 500;
+        std::vector<std::string> titleKeys, authorKeys;
+        for (size_t i = 0; i < TYPED_NAMES; ++i) {
+            const std::string& title = titles[picks[i] - 1];
+            const std::string& author = authors[picks[i] - 1];
+            for (size_t len = 1; len <= title.size(); ++len) titleKeys.push_back(title.substr(0, len));
+            for (size_t len = 1; len <= author.size(); ++len) authorKeys.push_back(author.substr(0, len));
+        }
+        runBenchmark("autocomplete_title_keystroke", titleKeys.size(), [&](size_t i) {
+            library.autocomplete(titleKeys[i], "title", 10);
+        });
+        runBenchmark("autocomplete_author_keystroke", authorKeys.size(), [&](size_t i) {
+            library.autocomplete(authorKeys[i], "author", 10);
+        });
+        runBenchmark("search_title_keystroke", std::min<size_t>(titleKeys.size(), 400), [&](size_t i) {
+            library.searchBookIds(titleKeys[i], "title");
+        });
+        // Misspelt queries: two letters swapped in the middle of an author or title
+        auto misspell = [](std::string text) {
+            if (text.size() >= 4) std::swap(text[text.size() / 2], text[text.size() / 2 + 1]);
+            return text;
+        };
+        runBenchmark("fuzzy_author_typo", SEARCH_QUERIES / 10, [&](size_t i) {
+            std::string query = misspell(authors[picks[i] - 1]);
+            library.fuzzySearch(query, LibrarySystem::defaultFuzzyDistance(query.size()), 20);
+        });
+        runBenchmark("fuzzy_title_typo", SEARCH_QUERIES / 10, [&](size_t i) {
+            std::string query = misspell(titles[picks[i] - 1]);
+            library.fuzzySearch(query, LibrarySystem::defaultFuzzyDistance(query.size()), 20);
+        });
+        runBenchmark("scan_title_nocase", SCANS, [&](size_t i) {
+            library.searchBookIds(titles[picks[i] - 1].substr(0, 2), "title", true);
+        });
+
+        // Substring kernels alone: one op is a pass over every title with a 4-byte needle
+        auto columnPass = [&](const char* name, auto&& find) {
+            volatile size_t hitSink = 0;
+            runBenchmark(name, SCANS, [&](size_t i) {
+                std::string needle = CaseFoldSearch::fold(titles[picks[i] - 1].substr(1, 4));
+                size_t hits = 0;
+                for (const std::string& title : titles) hits += find(title, needle) != std::string_view::npos;
+                hitSink = hits;
+            });
+        };
+        columnPass("kernel_find", [](std::string_view text, std::string_view needle) { return text.find(needle); });
+        columnPass("kernel_nocase_scalar", CaseFoldSearch::findScalar);
+#ifdef LIBRARY_X86_SIMD
+        columnPass("kernel_nocase_sse2", CaseFoldSearch::findSse2);
+        if (__builtin_cpu_supports("avx2")) columnPass("kernel_nocase_avx2", CaseFoldSearch::findAvx2);
+#endif
+        volatile size_t issuedSink = 0;
+        runBenchmark("count_issued", SCANS, [&](size_t) { issuedSink = library.bookCounts().second; });
+
+        std::vector<int> available;
+        for (size_t id = 1; id <= bookCount && available.size() < MUTATIONS; ++id) {
+            if (!onLoan[id]) available.push_back(static_cast<int>(id));
+        }
+        std::vector<int> borrowers(available.size());
+        for (auto& user : borrowers) user = generator.skewed(static_cast<int>(userCount)) + 1;
+        runBenchmark("issue_book", available.size(), [&](size_t i) {
+            library.issueBookOp(available[i], borrowers[i]);
+        });
+        runBenchmark("return_book", available.size(), [&](size_t i) {
+            library.returnBookOp(available[i]);
+        });
+
+        // Overdue sweep: one loan per book, a quarter still open and due over the
+        // next four weeks; a day later, the due-date heap against a ledger scan
+        {
+            const int64_t DAY = 24 * 60 * 60;
+            const int64_t START = 1700000000;
+            LoanLedger sweepLedger;
+            for (size_t i = 0; i < bookCount; ++i) {
+                int userId = generator.skewed(static_cast<int>(userCount)) + 1;
+                int64_t dueAt = START + generator.uniform(0, static_cast<int>(28 * DAY));
+                int loanId = sweepLedger.open(static_cast<int>(i + 1), userId, START, dueAt);
+                if (i % 4 != 0) sweepLedger.close(loanId, START);
+            }
+            volatile size_t overdueSink = 0;
+            runBenchmark("overdue_heap", SCANS, [&](size_t) { overdueSink = sweepLedger.dueBefore(START + DAY).size(); });
+            runBenchmark("overdue_scan", SCANS, [&](size_t) {
+                std::vector<Loan> due;
+                sweepLedger.forEach([&](const Loan& loan) {
+                    if (loan.isOpen() && loan.dueAt < START + DAY) due.push_back(loan);
+                });
+                std::sort(due.begin(), due.end(), [](const Loan& a, const Loan& b) { return a.dueAt < b.dueAt; });
+                overdueSink = due.size();
+            });
+        }
+
+        // Popular titles: thousands of patrons queue for each of a few books, then
+        // every return hands the book to the next in line and the rest cancel
+        {
+            const size_t HOT_TITLES = std::min<size_t>(10, available.size());
+            const size_t waiting = std::min<size_t>(userCount > 1 ? userCount - 1 : 0, 5000);
+            for (size_t t = 0; t < HOT_TITLES; ++t) library.issueBookOp(available[t], 1);
+            std::vector<int> holdIds;
+            holdIds.reserve(HOT_TITLES * waiting);
+            runBenchmark("place_hold", HOT_TITLES * waiting, [&](size_t i) {
+                holdIds.push_back(library.placeHoldOp(available[i % HOT_TITLES], static_cast<int>(i / HOT_TITLES) + 2).id);
+            });
+            runBenchmark("return_hold_handoff", HOT_TITLES * waiting / 2, [&](size_t i) {
+                library.returnBookOp(available[i % HOT_TITLES]);
+            });
+            // Cancel the rest from the middle of the lines
+            std::vector<int> cancels(holdIds.begin() + HOT_TITLES * waiting / 2, holdIds.end());
+            std::shuffle(cancels.begin(), cancels.end(), std::mt19937(seed));
+            runBenchmark("cancel_hold", cancels.size(), [&](size_t i) { library.cancelHoldOp(cancels[i]); });
+            for (size_t t = 0; t < HOT_TITLES; ++t) library.returnBookOp(available[t]);
+        }
+
+        runBenchmark("save_data", SAVE_LOAD_ROUNDS, [&](size_t) { library.saveData(); });
+
+        std::vector<int> victims(available.begin(), available.end());
+        runBenchmark("delete_book", victims.size(), [&](size_t i) { library.deleteBookOp(victims[i]); });
+    }
+
+    // Each load starts a fresh persistent system from the files saved above
+    double loadNs = 0;
+    for (size_t round = 0; round < SAVE_LOAD_ROUNDS; ++round) {
+        auto started = std::chrono::steady_clock::now();
+        auto loaded = std::make_unique<LibrarySystem>();
+        loadNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count();
+        loaded.reset();
+    }
+    double nsPerLoad = loadNs / SAVE_LOAD_ROUNDS;
+    std::printf("load_data,%zu,%.1f,%.0f,%ld\n", SAVE_LOAD_ROUNDS, nsPerLoad, 1e9 / nsPerLoad, peakRssKb());
+
+    return scratch.leave();
+}
+
+// Startup load of books.txt and users.txt on 1, 2, 4, ... threads, best of three
+// loads each. Loading is deterministic, so every row must show the same checksum.
+bool runLoadBenchmark(size_t bookCount, size_t userCount, size_t maxThreads) {
+    const size_t ROUNDS = 3;
+
+    ScratchDirectory scratch;
+    if (!scratch.ok()) return false;
+
+    {
+        CatalogGenerator generator(42, bookCount);
+        LibrarySystem library(false);
+        for (size_t i = 0; i < bookCount; ++i) {
+            library.addBookOp(generator.title(), generator.author(), CatalogGenerator::isbn(static_cast<int>(i + 1)));
+        }
+        for (size_t i = 0; i < userCount; ++i) {
+            library.addUserOp(generator.userName(), "user" + std::to_string(i + 1) + "@library.com");
+        }
+        for (size_t i = 0; i < bookCount / 4; ++i) {
+            library.issueBookOp(generator.uniform(1, static_cast<int>(bookCount)),
+                                generator.skewed(static_cast<int>(userCount)) + 1);
+        }
+        library.saveData();
+    }
+
+    std::cout << "Load benchmark: " << bookCount << " books, " << userCount << " users ("
+              << std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+    std::cout << std::left << std::setw(10) << "Threads" << std::setw(12) << "Load ms" << std::setw(10) << "Speedup"
+              << "Checksum" << std::endl;
+    std::cout << std::string(40, '-') << std::endl;
+
+    double baseline = 0;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        double best = 0;
+        uint32_t checksum = 0;
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            auto started = std::chrono::steady_clock::now();
+            auto loaded = std::make_unique<LibrarySystem>(true, threads);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+            if (round == 0 || ms < best) best = ms;
+            checksum = loaded->contentChecksum();
+        }
+        if (threads == 1) baseline = best;
+        char hex[16];
+        std::snprintf(hex, sizeof(hex), "%08x", checksum);
+        std::cout << std::setw(10) << threads << std::fixed << std::setprecision(1) << std::setw(12) << best
+                  << std::setprecision(2) << baseline / best << "x" << std::string(5, ' ') << hex << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+
+    return scratch.leave();
+}
+
+// Durable checkout throughput on 1, 2, 4, ... threads, each thread checking
+// out and returning its own 20 books: once as 40 single operations, each
+// waiting for its own commit, and once as two 20-operation transactions.
+// Records per fsync shows how far group commit spread each flush.
+bool runTransactionBenchmark(size_t maxThreads) {
+    const size_t BOOKS_PER_TXN = 20;
+    const size_t ROUNDS = 25;
+
+    ScratchDirectory scratch;
+    if (!scratch.ok()) return false;
+
+    bool consistent = true;
+    {
+        LibrarySystem library;
+        std::vector<int> userIds;
+        for (size_t t = 0; t < maxThreads; ++t) {
+            for (size_t i = 0; i < BOOKS_PER_TXN; ++i) {
+                int id = static_cast<int>(t * BOOKS_PER_TXN + i + 1);
+                library.addBookOp("Title " + std::to_string(id), "Author", CatalogGenerator::isbn(id));
+            }
+            userIds.push_back(library.addUserOp("Reader " + std::to_string(t), "reader" + std::to_string(t) + "@library.com").id);
+        }
+
+        std::cout << "Transaction benchmark: " << BOOKS_PER_TXN << " books per transaction, " << ROUNDS
+                  << " rounds per thread" << std::endl;
+        std::cout << std::left << std::setw(10) << "Threads" << std::setw(8) << "Mode" << std::setw(14) << "Book ops/s"
+                  << std::setw(10) << "Fsyncs" << "Records/fsync" << std::endl;
+        std::cout << std::string(55, '-') << std::endl;
+
+        for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+            for (bool transactional : {false, true}) {
+                std::pair<uint64_t, uint64_t> before = library.journalCommitCounts();
+                std::atomic<size_t> failures(0);
+                auto started = std::chrono::steady_clock::now();
+                std::vector<std::thread> workers;
+                for (size_t t = 0; t < threads; ++t) {
+                    workers.emplace_back([&, t]() {
+                        int firstBook = static_cast<int>(t * BOOKS_PER_TXN + 1);
+                        int userId = userIds[t];
+                        for (size_t round = 0; round < ROUNDS; ++round) {
+                            if (transactional) {
+                                Transaction checkout, checkin;
+                                for (size_t i = 0; i < BOOKS_PER_TXN; ++i) {
+                                    checkout.issue(firstBook + static_cast<int>(i), userId);
+                                    checkin.returnBook(firstBook + static_cast<int>(i));
+                                }
+                                if (!library.commitTransaction(checkout).ok) ++failures;
+                                if (!library.commitTransaction(checkin).ok) ++failures;
+                            } else {
+                                for (size_t i = 0; i < BOOKS_PER_TXN; ++i) {
+                                    if (!library.issueBookOp(firstBook + static_cast<int>(i), userId).ok) ++failures;
+                                }
+                                for (size_t i = 0; i < BOOKS_PER_TXN; ++i) {
+                                    if (!library.returnBookOp(firstBook + static_cast<int>(i)).ok) ++failures;
+                                }
+                            }
                         }
-                        case 8:
-                            viewUsers();
-                            break;
-                        case 9: {
-                            std::string query, searchType;
-                            std::cout << "Search by (title/author/isbn): ";
-                            std::cin >> searchType;
-                            std::cout << "Enter search query: ";
-                            std::cin.ignore();
-                            std::getline(std::cin, query);
-                            searchBooks(query, searchType);
-                            break;
+                    });
+                }
+                for (std::thread& worker : workers) worker.join();
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+                std::pair<uint64_t, uint64_t> after = library.journalCommitCounts();
+                uint64_t records = after.first - before.first;
+                uint64_t fsyncs = after.second - before.second;
+                if (failures > 0) consistent = false;
+
+                double bookOps = static_cast<double>(threads * ROUNDS * BOOKS_PER_TXN * 2);
+                std::cout << std::setw(10) << threads << std::setw(8) << (transactional ? "txn" : "single")
+                          << std::fixed << std::setprecision(0) << std::setw(14) << bookOps / seconds
+                          << std::setw(10) << fsyncs << std::setprecision(2)
+                          << (fsyncs > 0 ? static_cast<double>(records) / fsyncs : 0.0) << std::endl;
+                std::cout.unsetf(std::ios::fixed);
+            }
+        }
+    }
+    if (!consistent) std::cout << "Some operations failed; the results are not comparable" << std::endl;
+
+    return scratch.leave() && consistent;
+}
+
+// Writer throughput while 0, 1, 2, ... reader threads scan the whole catalog
+// from pinned snapshots. The writer alternates between checking two books out
+// and back in as transactions and churning extra books: it adds them eight
+// per transaction until there are half as many as the catalog holds, then
+// deletes them oldest first, which leaves enough holes for the store to
+// compact. Churned books have one-letter fields, so their cost is the version
+// tree's rather than the search indexes'. Every consistent snapshot therefore
+// sees an even issued count, a live row count matching its own size, and the
+// churned books as one gap-free ID range ending on a transaction boundary;
+// any torn view fails the run.
+bool runSnapshotBenchmark(size_t bookCount, size_t maxReaders) {
+    const auto ROUND_TIME = std::chrono::milliseconds(1000);
+    const size_t PAIRS = std::min<size_t>(bookCount / 2, 1024);
+    const size_t CHURN_BOOKS = std::max<size_t>(bookCount / 2, 64);
+    const int ADD_BATCH = 8;
+
+    LibrarySystem library(false);
+    CatalogGenerator generator(42, bookCount);
+    int lastBaseId = 0;
+    for (size_t i = 0; i < bookCount; ++i) {
+        lastBaseId = library.addBookOp(generator.title(), generator.author(),
+                                       CatalogGenerator::isbn(static_cast<int>(i + 1))).id;
+    }
+    int userId = library.addUserOp("Reader", "reader@library.com").id;
+
+    std::cout << "Snapshot benchmark: " << bookCount << " books, " << ROUND_TIME.count() << " ms per round"
+              << std::endl;
+    std::cout << std::left << std::setw(10) << "Readers" << std::setw(12) << "Scans/s" << std::setw(16)
+              << "Writer ops/s" << std::setw(16) << "Max write us" << "Consistent" << std::endl;
+    std::cout << std::string(64, '-') << std::endl;
+
+    bool consistent = true;
+    size_t pairSteps = 0;
+    size_t churnLive = 0;
+    int oldestChurn = lastBaseId + 1;
+    bool shrinking = false;
+    size_t compactions = 0;
+    for (size_t readers = 0; readers <= maxReaders; readers = readers == 0 ? 1 : readers * 2) {
+        std::atomic<bool> stop(false);
+        std::atomic<size_t> scans(0);
+        std::atomic<size_t> torn(0);
+        std::vector<std::thread> scanners;
+        for (size_t r = 0; r < readers; ++r) {
+            scanners.emplace_back([&]() {
+                while (!stop.load(std::memory_order_relaxed)) {
+                    CatalogVersions::Snapshot snapshot = library.catalogSnapshot();
+                    size_t live = 0, issued = 0, churned = 0;
+                    int lowest = std::numeric_limits<int>::max(), highest = 0;
+                    snapshot.forEachLive([&](size_t slot) {
+                        ++live;
+                        if (snapshot.isIssued(slot)) ++issued;
+                        int id = snapshot.bookId(slot);
+                        if (id > lastBaseId) {
+                            ++churned;
+                            lowest = std::min(lowest, id);
+                            highest = std::max(highest, id);
                         }
-                        case 10:
-                            adminLogout();
-                            std::cout << "Logged out successfully!" << std::endl;
-                            break;
+                    });
+                    bool churnIntact = churned == 0 || (churned == static_cast<size_t>(highest - lowest) + 1 &&
+                                                        (highest - lastBaseId) % ADD_BATCH == 0);
+                    if (live != snapshot.size() || issued != snapshot.issuedCount() || issued % 2 != 0 ||
+                        !churnIntact) {
+                        ++torn;
                     }
+                    ++scans;
                 }
-            } catch (const std::exception& e) {
-                std::cout << "An error occurred: " << e.what() << std::endl;
+            });
+        }
+
+        size_t writes = 0, failures = 0;
+        std::chrono::steady_clock::duration slowest{};
+        auto started = std::chrono::steady_clock::now();
+        while (std::chrono::steady_clock::now() - started < ROUND_TIME) {
+            auto before = std::chrono::steady_clock::now();
+            bool ok;
+            if (writes % 2 == 0) {
+                int first = static_cast<int>((pairSteps / 2) % PAIRS) * 2 + 1;
+                Transaction step;
+                if (pairSteps % 2 == 0) {
+                    step.issue(first, userId);
+                    step.issue(first + 1, userId);
+                } else {
+                    step.returnBook(first);
+                    step.returnBook(first + 1);
+                }
+                ok = library.commitTransaction(step).ok;
+                ++pairSteps;
+            } else if (!shrinking) {
+                Transaction step;
+                for (int i = 0; i < ADD_BATCH; ++i) step.addBook("C", "W", "");
+                ok = library.commitTransaction(step).ok;
+                churnLive += ADD_BATCH;
+                shrinking = churnLive >= CHURN_BOOKS;
+            } else {
+                size_t slots = library.catalogSnapshot().slotCount();
+                ok = library.deleteBookOp(oldestChurn++).ok;
+                if (library.catalogSnapshot().slotCount() < slots) ++compactions;
+                shrinking = --churnLive > 0;
+            }
+            if (!ok) ++failures;
+            slowest = std::max(slowest, std::chrono::steady_clock::now() - before);
+            ++writes;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        stop = true;
+        for (std::thread& scanner : scanners) scanner.join();
+        if (pairSteps % 2 != 0) {
+            // Leave the pair returned for the next round
+            int first = static_cast<int>((pairSteps / 2) % PAIRS) * 2 + 1;
+            Transaction step;
+            step.returnBook(first);
+            step.returnBook(first + 1);
+            if (!library.commitTransaction(step).ok) ++failures;
+            ++pairSteps;
+        }
+        bool roundConsistent = torn == 0 && failures == 0;
+        if (!roundConsistent) consistent = false;
+
+        std::cout << std::setw(10) << readers << std::fixed << std::setprecision(1) << std::setw(12)
+                  << scans / seconds << std::setprecision(0) << std::setw(16) << writes / seconds << std::setw(16)
+                  << std::chrono::duration<double, std::micro>(slowest).count()
+                  << (roundConsistent ? "yes" : "NO") << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+    std::cout << "Book store compactions during the run: " << compactions << std::endl;
+    if (!consistent) std::cout << "A reader saw a torn snapshot or a write failed" << std::endl;
+    return consistent;
+}
+
+// Admin login cost as the patron table grows from 1k to 1M users. Logins are
+// a hash lookup plus a fixed-cost password hash, so the cost should stay flat.
+void runLoginBenchmark() {
+    const size_t ADMIN_COUNT = 200;
+    const size_t LOGINS = 20;
+    const size_t PATRON_STEPS[] = {1000, 10000, 100000, 1000000};
+
+    LibrarySystem library(false);
+    for (size_t i = 0; i < ADMIN_COUNT; ++i) {
+        library.addUserOp("Staff " + std::to_string(i), "staff" + std::to_string(i) + "@library.com", true,
+                          "staff" + std::to_string(i), "password" + std::to_string(i));
+    }
+
+    std::printf("# admins=%zu password_hash_iterations=%u\n", ADMIN_COUNT, PASSWORD_HASH_ITERATIONS);
+    std::printf("benchmark,iterations,ns_per_op,ops_per_s,peak_rss_kb\n");
+    size_t patrons = 0;
+    for (size_t target : PATRON_STEPS) {
+        for (; patrons < target; ++patrons) {
+            library.addUserOp("Patron " + std::to_string(patrons), "patron" + std::to_string(patrons) + "@library.com");
+        }
+        std::string hit = "admin_login_hit_" + std::to_string(target);
+        runBenchmark(hit.c_str(), LOGINS, [&](size_t i) {
+            size_t admin = (i * 37) % ADMIN_COUNT;
+            library.adminLogin("staff" + std::to_string(admin), "password" + std::to_string(admin));
+        });
+        std::string miss = "admin_login_unknown_" + std::to_string(target);
+        runBenchmark(miss.c_str(), LOGINS, [&](size_t i) {
+            library.adminLogin("nobody" + std::to_string(i), "password");
+        });
+    }
+}
+#endif
+
+#ifdef __linux__
+// Raise the open file limit as far as allowed, so one process can hold 10k+ sockets
+static void raiseFileLimit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+static bool fillSocketAddress(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return false;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+static volatile std::sig_atomic_t serverStopRequested = 0;
+
+static void requestServerStop(int) { serverStopRequested = 1; }
+
+// Single-threaded epoll front end sharing one LibrarySystem between many
+// clients over a Unix domain socket. One request per line; requests may be
+// pipelined and replies come back in request order:
+//   <batch command> args      -> OK <id> | ERR <message>   (see runBatch)
+//   SEARCH <type> <query>     -> OK <n> followed by n book lines
+//   ISEARCH <type> <query>    -> as SEARCH, ignoring ASCII case
+//   RANKED <k> <cursor|-> <q> -> OK <n> <next cursor|-> followed by n lines
+//                                id|score|title|author, best first
+//   COMPLETE <type> <n> <pfx> -> OK <m> followed by up to n titles or authors
+//   ISBN <isbn>               -> OK <id> | ERR <message>  (ISBN-10 or -13)
+//   FUZZY <n> <query>         -> OK <m> followed by up to n lines
+//                                id|distance|title|author, closest first
+//   VIEW                      -> OK <n> followed by n book lines
+//   STATS                     -> OK <n> followed by n lines of statistics
+//   PING                      -> OK 0
+//   BEGIN                     -> OK 0; later ISSUE, RETURN, ADD_BOOK and
+//                                ADD_USER lines are queued, each -> OK <k>
+//   COMMIT                    -> OK <n> once all n are applied and durable,
+//                                or ERR <message> (operation k), nothing applied
+//   ABORT                     -> OK 0, queued operations dropped
+//   QUIT                      -> connection closed after pending replies
+// In '|'-separated lines, '|' and '\' inside titles and authors are escaped
+// with a backslash. OK to a change is sent only after its journal fsync; if
+// that fails the change is rolled back and the reply is ERR instead.
+// Book lines are id|title|author|isbn|status|userId. Mutations handled in one
+// event loop iteration share a single journal fsync before any reply is sent.
+class LibraryServer {
+private:
+    struct Connection {
+        int fd;
+        std::string input;
+        std::deque<std::string> replies;  // flushed with writev
+        size_t replyOffset = 0;           // bytes of replies.front() already sent
+        bool closing = false;
+        bool watchingWrites = false;
+        std::unique_ptr<Transaction> txn;  // open between BEGIN and COMMIT/ABORT
+        bool txnRejected = false;          // a queued line was malformed, so COMMIT fails
+        // Mutation replies queued this round, as (index in replies, journal
+        // LSN); they become errors if the round's sync fails
+        std::vector<std::pair<size_t, uint64_t>> unsynced;
+    };
+
+    static constexpr size_t MAX_EVENTS = 1024;
+    static constexpr size_t MAX_IOVECS = 64;
+    static constexpr size_t MAX_LINE_LENGTH = 64 * 1024;
+
+    LibrarySystem& library;
+    std::string socketPath;
+    int listenFd;
+    int epollFd;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::vector<Connection*> readyToFlush;
+    bool mutatedThisRound;
+    size_t acceptedTotal;
+    size_t requestsTotal;
+
+    // Text inside a '|'-separated reply line, with '|' and '\' backslash-escaped
+    static void appendField(std::string& out, std::string_view text) {
+        for (char c : text) {
+            if (c == '|' || c == '\\') out += '\\';
+            out += c;
+        }
+    }
+
+    static void appendBookLine(std::string& out, const Book& book) {
+        out += std::to_string(book.getBookId());
+        out += '|';
+        appendField(out, book.getTitle());
+        out += '|';
+        appendField(out, book.getAuthor());
+        out += '|';
+        out += book.getIsbn();
+        out += book.getIsIssued() ? "|Issued|" : "|Available|";
+        out += std::to_string(book.getIssuedToUserId());
+        out += '\n';
+    }
+
+    static std::string bookListReply(const std::vector<Book>& list) {
+        std::string reply = "OK " + std::to_string(list.size()) + "\n";
+        for (const auto& book : list) appendBookLine(reply, book);
+        return reply;
+    }
+
+    static constexpr size_t MAX_PAGE_SIZE = 1000;
+
+    // Queue the reply to a change; it is sent only once the round's journal
+    // sync has made the change durable
+    void replyChanged(Connection& conn, std::string reply) {
+        mutatedThisRound = true;
+        conn.unsynced.emplace_back(conn.replies.size(), library.journalCommitCounts().first);
+        conn.replies.push_back(std::move(reply));
+    }
+
+    // After the round's sync: a failed sync rolled back every change not yet
+    // on disk, so their replies turn into journal errors
+    void settleChangedReplies(bool synced) {
+        uint64_t durable = synced ? 0 : library.journalDurableThrough();
+        for (Connection* conn : readyToFlush) {
+            for (const auto& [index, lsn] : conn->unsynced) {
+                if (!synced && lsn > durable) conn->replies[index] = std::string("ERR ") + ERR_JOURNAL + "\n";
+            }
+            conn->unsynced.clear();
+        }
+    }
+
+    // RANKED <k> <cursor|-> <query>
+    void handleRanked(Connection& conn, std::string_view rest) {
+        size_t kEnd = rest.find(' ');
+        size_t cursorEnd = kEnd == std::string_view::npos ? kEnd : rest.find(' ', kEnd + 1);
+        size_t k = 0;
+        SearchCursor cursor;
+        bool valid = cursorEnd != std::string_view::npos;
+        if (valid) {
+            auto parsed = std::from_chars(rest.data(), rest.data() + kEnd, k);
+            std::string_view cursorText = rest.substr(kEnd + 1, cursorEnd - kEnd - 1);
+            valid = parsed.ec == std::errc() && parsed.ptr == rest.data() + kEnd && k > 0 && k <= MAX_PAGE_SIZE &&
+                    (cursorText == "-" || SearchCursor::parse(cursorText, cursor));
+        }
+        if (!valid) {
+            conn.replies.push_back("ERR expected RANKED <1-1000> <cursor|-> <query>\n");
+            return;
+        }
+
+        RankedPage page = library.rankedSearch(std::string(rest.substr(cursorEnd + 1)), k, cursor);
+        std::string reply = "OK " + std::to_string(page.hits.size()) + " " +
+                            (page.hasMore ? page.next.toString() : std::string("-")) + "\n";
+        for (const auto& hit : page.hits) {
+            reply += std::to_string(hit.bookId);
+            reply += '|';
+            reply += std::to_string(hit.score);
+            reply += '|';
+            appendField(reply, hit.title);
+            reply += '|';
+            appendField(reply, hit.author);
+            reply += '\n';
+        }
+        conn.replies.push_back(std::move(reply));
+    }
+
+    // COMPLETE title|author <n> <prefix>; the prefix may be empty
+    void handleComplete(Connection& conn, std::string_view rest) {
+        size_t typeEnd = rest.find(' ');
+        std::string type(rest.substr(0, typeEnd));
+        size_t limitEnd = typeEnd == std::string_view::npos ? typeEnd : rest.find(' ', typeEnd + 1);
+        size_t limit = 0;
+        bool valid = typeEnd != std::string_view::npos && (type == "title" || type == "author");
+        if (valid) {
+            std::string_view limitText = rest.substr(typeEnd + 1, limitEnd - typeEnd - 1);
+            auto parsed = std::from_chars(limitText.data(), limitText.data() + limitText.size(), limit);
+            valid = parsed.ec == std::errc() && parsed.ptr == limitText.data() + limitText.size() && limit > 0 &&
+                    limit <= MAX_PAGE_SIZE;
+        }
+        if (!valid) {
+            conn.replies.push_back("ERR expected COMPLETE title|author <1-1000> <prefix>\n");
+            return;
+        }
+
+        std::string prefix = limitEnd == std::string_view::npos ? std::string() : std::string(rest.substr(limitEnd + 1));
+        std::vector<std::string_view> completions = library.autocomplete(prefix, type, limit);
+        std::string reply = "OK " + std::to_string(completions.size()) + "\n";
+        for (std::string_view text : completions) {
+            reply += text;
+            reply += '\n';
+        }
+        conn.replies.push_back(std::move(reply));
+    }
+
+    // FUZZY <n> <query>, tolerating the default number of typos for the query length
+    void handleFuzzy(Connection& conn, std::string_view rest) {
+        size_t limitEnd = rest.find(' ');
+        size_t limit = 0;
+        auto parsed = std::from_chars(rest.data(), rest.data() + std::min(limitEnd, rest.size()), limit);
+        if (limitEnd == std::string_view::npos || parsed.ec != std::errc() || parsed.ptr != rest.data() + limitEnd ||
+            limit == 0 || limit > MAX_PAGE_SIZE) {
+            conn.replies.push_back("ERR expected FUZZY <1-1000> <query>\n");
+            return;
+        }
+
+        std::string query(rest.substr(limitEnd + 1));
+        std::vector<FuzzyHit> hits =
+            library.fuzzySearch(query, LibrarySystem::defaultFuzzyDistance(query.size()), limit);
+        std::string reply = "OK " + std::to_string(hits.size()) + "\n";
+        for (const auto& hit : hits) {
+            reply += std::to_string(hit.bookId);
+            reply += '|';
+            reply += std::to_string(hit.distance);
+            reply += '|';
+            appendField(reply, hit.title);
+            reply += '|';
+            appendField(reply, hit.author);
+            reply += '\n';
+        }
+        conn.replies.push_back(std::move(reply));
+    }
+
+    // OVERDUE [asOf]: open loans due before asOf (Unix seconds, default now)
+    void handleOverdue(Connection& conn, std::string_view rest) {
+        int64_t asOf = static_cast<int64_t>(std::time(nullptr));
+        if (!rest.empty() && !parseInt(rest, asOf)) {
+            conn.replies.push_back("ERR expected OVERDUE [unix-time]\n");
+            return;
+        }
+        std::vector<Loan> overdue = library.overdueLoans(asOf);
+        std::string reply = "OK " + std::to_string(overdue.size()) + "\n";
+        for (const Loan& loan : overdue) {
+            appendInt(reply, loan.loanId);
+            reply += '|';
+            appendInt(reply, loan.bookId);
+            reply += '|';
+            appendInt(reply, loan.userId);
+            reply += '|';
+            appendInt(reply, loan.issuedAt);
+            reply += '|';
+            appendInt(reply, loan.dueAt);
+            reply += '\n';
+        }
+        conn.replies.push_back(std::move(reply));
+    }
+
+    // HOLDS <bookId>: the book's line, first in line first
+    void handleHolds(Connection& conn, std::string_view rest) {
+        int bookId = 0;
+        if (!parseInt(rest, bookId)) {
+            conn.replies.push_back("ERR expected HOLDS <book id>\n");
+            return;
+        }
+        std::vector<Hold> line = library.holdQueue(bookId);
+        std::string reply = "OK " + std::to_string(line.size()) + "\n";
+        for (const Hold& hold : line) {
+            appendInt(reply, hold.holdId);
+            reply += '|';
+            appendInt(reply, hold.userId);
+            reply += '|';
+            appendInt(reply, hold.placedAt);
+            reply += '\n';
+        }
+        conn.replies.push_back(std::move(reply));
+    }
+
+    // BEGIN, COMMIT, ABORT and the lines queued in between. Each queued line
+    // answers OK <position>; COMMIT answers OK <operations> once durable.
+    void handleTransactionLine(Connection& conn, CommandType command, std::string_view rest) {
+        if (command == CMD_BEGIN) {
+            if (conn.txn) {
+                conn.replies.push_back("ERR transaction already open\n");
+                return;
+            }
+            conn.txn = std::make_unique<Transaction>();
+            conn.txnRejected = false;
+            conn.replies.push_back("OK 0\n");
+        } else if (!conn.txn) {
+            conn.replies.push_back("ERR no open transaction\n");
+        } else if (command == CMD_ABORT) {
+            conn.txn.reset();
+            conn.replies.push_back("OK 0\n");
+        } else if (command == CMD_COMMIT) {
+            std::unique_ptr<Transaction> txn = std::move(conn.txn);
+            if (conn.txnRejected) {
+                conn.replies.push_back("ERR transaction had a rejected operation, nothing applied\n");
+                return;
+            }
+            TransactionResult result = library.commitTransaction(*txn);
+            if (result.ok) {
+                replyChanged(conn, "OK " + std::to_string(txn->size()) + "\n");
+            } else {
+                std::string reply = std::string("ERR ") + result.error;
+                if (result.failedOp < txn->size()) reply += " (operation " + std::to_string(result.failedOp + 1) + ")";
+                conn.replies.push_back(reply + ", nothing applied\n");
+            }
+        } else if (const char* error = conn.txn->add(command, rest)) {
+            conn.txnRejected = true;
+            conn.replies.push_back(std::string("ERR ") + error + "\n");
+        } else {
+            conn.replies.push_back("OK " + std::to_string(conn.txn->size()) + "\n");
+        }
+    }
+
+    // Execute one request line and queue its reply
+    void handleRequest(Connection& conn, std::string_view line) {
+        ++requestsTotal;
+        size_t space = line.find(' ');
+        std::string_view word = line.substr(0, space);
+        std::string_view rest = space == std::string_view::npos ? std::string_view() : line.substr(space + 1);
+
+        if (word == "SEARCH" || word == "ISEARCH") {
+            size_t typeEnd = rest.find(' ');
+            std::string type(rest.substr(0, typeEnd));
+            if (typeEnd == std::string_view::npos || (type != "title" && type != "author" && type != "isbn")) {
+                conn.replies.push_back("ERR expected " + std::string(word) + " title|author|isbn <query>\n");
+                return;
+            }
+            conn.replies.push_back(bookListReply(
+                library.findBooks(std::string(rest.substr(typeEnd + 1)), type, word == "ISEARCH")));
+        } else if (word == "RANKED") {
+            handleRanked(conn, rest);
+        } else if (word == "COMPLETE") {
+            handleComplete(conn, rest);
+        } else if (word == "FUZZY") {
+            handleFuzzy(conn, rest);
+        } else if (word == "OVERDUE") {
+            handleOverdue(conn, rest);
+        } else if (word == "HOLDS") {
+            handleHolds(conn, rest);
+        } else if (word == "ISBN") {
+            int bookId = library.findBookByIsbn(std::string(rest));
+            conn.replies.push_back(bookId < 0 ? std::string("ERR ") + ERR_BOOK_NOT_FOUND + "\n"
+                                              : "OK " + std::to_string(bookId) + "\n");
+        } else if (word == "VIEW") {
+            conn.replies.push_back(bookListReply(library.getAllBooks()));
+        } else if (word == "STATS") {
+            std::string report = library.statsReport();
+            conn.replies.push_back("OK " + std::to_string(std::count(report.begin(), report.end(), '\n')) + "\n" +
+                                   report);
+        } else if (word == "PING") {
+            conn.replies.push_back("OK 0\n");
+        } else if (word == "QUIT") {
+            conn.closing = true;
+        } else {
+            CommandType command = parseCommand(word);
+            if (conn.txn || command == CMD_BEGIN || command == CMD_COMMIT || command == CMD_ABORT) {
+                handleTransactionLine(conn, command, rest);
+                return;
+            }
+            OpResult result = library.executeCommand(command, rest);
+            if (result.ok) {
+                replyChanged(conn, "OK " + std::to_string(result.id) + "\n");
+            } else {
+                conn.replies.push_back(std::string("ERR ") + result.error + "\n");
+            }
+        }
+    }
+
+    void acceptClients() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EMFILE || errno == ENFILE) {
+                    std::cout << "Warning: out of file descriptors, connection deferred" << std::endl;
+                }
+                return;
+            }
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLRDHUP;
+            event.data.fd = fd;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+                ::close(fd);
+                continue;
+            }
+            auto conn = std::make_unique<Connection>();
+            conn->fd = fd;
+            connections[fd] = std::move(conn);
+            ++acceptedTotal;
+        }
+    }
+
+    void closeConnection(int fd) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections.erase(fd);
+    }
+
+    // Read what is available and run every complete line; false once the peer is gone
+    bool readRequests(Connection& conn) {
+        char buffer[64 * 1024];
+        ssize_t got = ::read(conn.fd, buffer, sizeof(buffer));
+        if (got == 0) return false;
+        if (got < 0) return errno == EAGAIN || errno == EINTR;
+        conn.input.append(buffer, static_cast<size_t>(got));
+
+        size_t start = 0;
+        while (!conn.closing) {
+            size_t end = conn.input.find('\n', start);
+            if (end == std::string::npos) break;
+            std::string_view line(conn.input.data() + start, end - start);
+            start = end + 1;
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (!line.empty()) handleRequest(conn, line);
+        }
+        conn.input.erase(0, start);
+        if (conn.input.size() > MAX_LINE_LENGTH) {
+            conn.replies.push_back("ERR request too long\n");
+            conn.closing = true;
+        }
+        if (!conn.replies.empty() || conn.closing) readyToFlush.push_back(&conn);
+        return true;
+    }
+
+    // Send queued replies with gathered writes; false once the connection should close
+    bool flushReplies(Connection& conn) {
+        while (!conn.replies.empty()) {
+            iovec parts[MAX_IOVECS];
+            size_t count = 0;
+            for (auto it = conn.replies.begin(); it != conn.replies.end() && count < MAX_IOVECS; ++it, ++count) {
+                size_t skip = count == 0 ? conn.replyOffset : 0;
+                parts[count].iov_base = const_cast<char*>(it->data() + skip);
+                parts[count].iov_len = it->size() - skip;
+            }
+            ssize_t sent = ::writev(conn.fd, parts, static_cast<int>(count));
+            if (sent < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN) return false;
+                break;
+            }
+            size_t remaining = static_cast<size_t>(sent);
+            while (remaining > 0) {
+                size_t left = conn.replies.front().size() - conn.replyOffset;
+                if (remaining < left) {
+                    conn.replyOffset += remaining;
+                    break;
+                }
+                remaining -= left;
+                conn.replies.pop_front();
+                conn.replyOffset = 0;
+            }
+        }
+
+        if (conn.replies.empty() && conn.closing) return false;
+
+        // Only wait for writability while replies are backed up; a closing
+        // connection stops reading
+        bool wantWrites = !conn.replies.empty();
+        if (wantWrites != conn.watchingWrites || conn.closing) {
+            epoll_event event{};
+            event.events = conn.closing ? 0 : EPOLLIN | EPOLLRDHUP;
+            if (wantWrites) event.events |= EPOLLOUT;
+            event.data.fd = conn.fd;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, conn.fd, &event);
+            conn.watchingWrites = wantWrites;
+        }
+        return true;
+    }
+
+public:
+    LibraryServer(LibrarySystem& lib, const std::string& path)
+        : library(lib), socketPath(path), listenFd(-1), epollFd(-1),
+          mutatedThisRound(false), acceptedTotal(0), requestsTotal(0) {}
+
+    ~LibraryServer() {
+        for (auto& entry : connections) ::close(entry.first);
+        if (epollFd >= 0) ::close(epollFd);
+        if (listenFd >= 0) {
+            ::close(listenFd);
+            ::unlink(socketPath.c_str());
+        }
+    }
+
+    bool start() {
+        sockaddr_un address;
+        if (!fillSocketAddress(socketPath, address)) {
+            std::cout << "Socket path too long: " << socketPath << std::endl;
+            return false;
+        }
+        raiseFileLimit();
+        ::unlink(socketPath.c_str());
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (listenFd < 0 || epollFd < 0 ||
+            bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+            listen(listenFd, SOMAXCONN) < 0) {
+            std::cout << "Cannot listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = listenFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+        return true;
+    }
+
+    // Serve until SIGINT or SIGTERM
+    void run() {
+        std::signal(SIGPIPE, SIG_IGN);
+        std::signal(SIGINT, requestServerStop);
+        std::signal(SIGTERM, requestServerStop);
+        library.setSyncCommit(false);
+        std::cout << "Library server listening on " << socketPath << " (Ctrl+C to stop)" << std::endl;
+
+        std::vector<epoll_event> events(MAX_EVENTS);
+        std::vector<int> dropped;
+        while (!serverStopRequested) {
+            int ready = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), -1);
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                std::cout << "epoll_wait failed: " << std::strerror(errno) << std::endl;
+                break;
+            }
+
+            readyToFlush.clear();
+            dropped.clear();
+            mutatedThisRound = false;
+            for (int i = 0; i < ready; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == listenFd) {
+                    acceptClients();
+                    continue;
+                }
+                auto it = connections.find(fd);
+                if (it == connections.end()) continue;
+                Connection& conn = *it->second;
+                uint32_t flags = events[i].events;
+                if ((flags & EPOLLIN) && !conn.closing && !readRequests(conn)) {
+                    dropped.push_back(fd);
+                } else if (flags & EPOLLOUT) {
+                    readyToFlush.push_back(&conn);
+                } else if (flags & (EPOLLERR | EPOLLHUP)) {
+                    dropped.push_back(fd);
+                }
+            }
+
+            // Group commit: one fsync covers every mutation made this round,
+            // and no reply to a mutation goes out before it
+            if (mutatedThisRound) {
+                bool synced = library.syncJournal();
+                if (!synced) std::cout << "Error: " << ERR_JOURNAL << std::endl;
+                settleChangedReplies(synced);
+            }
+
+            for (Connection* conn : readyToFlush) {
+                if (std::find(dropped.begin(), dropped.end(), conn->fd) != dropped.end()) continue;
+                if (!flushReplies(*conn)) dropped.push_back(conn->fd);
+            }
+            for (int fd : dropped) {
+                if (connections.count(fd)) closeConnection(fd);
             }
         }
+
+        library.setSyncCommit(true);
+        std::cout << "\nServer stopped after " << acceptedTotal << " connections and "
+                  << requestsTotal << " requests." << std::endl;
     }
 };
 
+// Load generator for LibraryServer: opens many connections, keeps `depth`
+// read-only requests in flight on each, and reports latency percentiles
+bool runLoadGenerator(size_t connectionCount, size_t requestsPerConnection, size_t depth,
+                      const std::string& socketPath) {
+    struct Client {
+        int fd;
+        std::deque<std::chrono::steady_clock::time_point> inFlight;
+        std::deque<bool> expectsList;   // SEARCH replies carry a row count
+        std::string input;
+        std::string output;
+        size_t rowsPending = 0;
+        size_t sent = 0;
+        std::mt19937 rng;
+    };
+
+    if (connectionCount == 0 || requestsPerConnection == 0) {
+        std::cout << "Need at least one connection and one request per connection" << std::endl;
+        return false;
+    }
+    sockaddr_un address;
+    if (!fillSocketAddress(socketPath, address)) {
+        std::cout << "Socket path too long: " << socketPath << std::endl;
+        return false;
+    }
+    raiseFileLimit();
+    std::signal(SIGPIPE, SIG_IGN);
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<Client> clients(connectionCount);
+    for (size_t i = 0; i < connectionCount; ++i) {
+        // Blocking connects simply wait while the server drains its accept backlog
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            std::cout << "Connection " << i << " failed: " << std::strerror(errno) << std::endl;
+            if (fd >= 0) ::close(fd);
+            for (size_t j = 0; j < i; ++j) ::close(clients[j].fd);
+            ::close(epollFd);
+            return false;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        clients[i].fd = fd;
+        clients[i].rng.seed(static_cast<unsigned>(i + 1));
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = i;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    std::vector<uint32_t> latencies;  // microseconds
+    latencies.reserve(connectionCount * requestsPerConnection);
+    size_t errors = 0;
+
+    // Queue and send requests until `depth` are outstanding; 90% searches, 10% pings
+    auto topUp = [&](Client& client) {
+        while (client.sent < requestsPerConnection && client.inFlight.size() < depth) {
+            bool search = client.rng() % 10 != 0;
+            if (search) {
+                client.output += "SEARCH title " + std::to_string(100 + client.rng() % 99900) + "\n";
+            } else {
+                client.output += "PING\n";
+            }
+            client.expectsList.push_back(search);
+            client.inFlight.push_back(std::chrono::steady_clock::now());
+            ++client.sent;
+        }
+        while (!client.output.empty()) {
+            ssize_t written = ::write(client.fd, client.output.data(), client.output.size());
+            if (written <= 0) break;  // retried once the next reply arrives
+            client.output.erase(0, static_cast<size_t>(written));
+        }
+    };
+
+    auto started = std::chrono::steady_clock::now();
+    for (auto& client : clients) topUp(client);
+
+    size_t finished = 0;
+    std::vector<epoll_event> events(1024);
+    while (finished < connectionCount) {
+        int ready = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < ready; ++i) {
+            Client& client = clients[events[i].data.u64];
+            char buffer[64 * 1024];
+            ssize_t got = ::read(client.fd, buffer, sizeof(buffer));
+            if (got <= 0) {
+                if (got < 0 && errno == EAGAIN) continue;
+                std::cout << "Server closed a connection early" << std::endl;
+                finished = connectionCount;
+                break;
+            }
+            client.input.append(buffer, static_cast<size_t>(got));
+
+            size_t start = 0;
+            size_t end;
+            while ((end = client.input.find('\n', start)) != std::string::npos) {
+                std::string_view line(client.input.data() + start, end - start);
+                start = end + 1;
+                if (client.rowsPending > 0) {
+                    if (--client.rowsPending > 0) continue;
+                } else {
+                    bool list = client.expectsList.front();
+                    if (line.substr(0, 3) != "OK ") {
+                        ++errors;
+                    } else if (list) {
+                        int rows = 0;
+                        parseInt(line.substr(3), rows);
+                        client.rowsPending = static_cast<size_t>(rows);
+                        if (rows > 0) continue;
+                    }
+                }
+                // Reply complete
+                auto elapsed = std::chrono::steady_clock::now() - client.inFlight.front();
+                latencies.push_back(static_cast<uint32_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+                client.inFlight.pop_front();
+                client.expectsList.pop_front();
+                if (client.inFlight.empty() && client.sent == requestsPerConnection) ++finished;
+            }
+            client.input.erase(0, start);
+            topUp(client);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    for (auto& client : clients) ::close(client.fd);
+    ::close(epollFd);
+    if (latencies.empty()) return false;
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1))]; };
+    std::cout << "Connections:     " << connectionCount << " (pipeline depth " << depth << ")" << std::endl;
+    std::cout << "Requests:        " << latencies.size() << " (" << errors << " errors)" << std::endl;
+    std::cout << "Throughput:      " << static_cast<long long>(latencies.size() / seconds) << " req/s" << std::endl;
+    std::cout << "Latency p50:     " << percentile(0.50) << " us" << std::endl;
+    std::cout << "Latency p99:     " << percentile(0.99) << " us" << std::endl;
+    std::cout << "Latency p99.9:   " << percentile(0.999) << " us" << std::endl;
+    std::cout << "Latency max:     " << latencies.back() << " us" << std::endl;
+    return true;
+}
+#endif
+
+// Numeric command-line argument `index`, or `fallback` when it is absent.
+// Prints an error and returns false if it is not a whole number.
+static bool numericArg(int argc, char* argv[], int index, size_t fallback, size_t& value) {
+    value = fallback;
+    if (argc <= index || parseInt(std::string_view(argv[index]), value)) return true;
+    std::cout << "Expected a whole number, got: " << argv[index] << std::endl;
+    return false;
+}
+
 // Main function
-int main() {
+int main(int argc, char* argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "--to-binary" || mode == "--to-text") {
+        if (argc != 5) {
+            std::cout << "Usage: " << argv[0] << " --to-binary <books.txt> <users.txt> <library.snap>" << std::endl;
+            std::cout << "       " << argv[0] << " --to-text <library.snap> <books.txt> <users.txt>" << std::endl;
+            return 1;
+        }
+        bool ok = mode == "--to-binary" ? convertTextToBinary(argv[2], argv[3], argv[4])
+                                        : convertBinaryToText(argv[2], argv[3], argv[4]);
+        return ok ? 0 : 1;
+    }
+
+    if (mode == "--stress") {
+        size_t maxThreads;
+        if (!numericArg(argc, argv, 2, std::max(1u, std::thread::hardware_concurrency()), maxThreads)) return 1;
+        return runStressTest(std::max<size_t>(1, maxThreads)) ? 0 : 1;
+    }
+
+    if (mode == "--batch") {
+        if (argc != 3) {
+            std::cout << "Usage: " << argv[0] << " --batch <commands.txt | ->" << std::endl;
+            return 1;
+        }
+        try {
+            LibrarySystem library;
+            return library.runBatch(argv[2]) ? 0 : 1;
+        } catch (const std::exception& e) {
+            std::cout << "Fatal error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    if (mode == "--bench") {
+        size_t bookCount, userCount, seed;
+        if (!numericArg(argc, argv, 2, 100000, bookCount) || !numericArg(argc, argv, 3, 10000, userCount) ||
+            !numericArg(argc, argv, 4, 42, seed)) {
+            return 1;
+        }
+        return runBenchmarks(std::max<size_t>(1, bookCount), std::max<size_t>(1, userCount),
+                             static_cast<unsigned>(seed)) ? 0 : 1;
+    }
+
+    if (mode == "--bench-load") {
+        size_t bookCount, userCount, maxThreads;
+        if (!numericArg(argc, argv, 2, 200000, bookCount) || !numericArg(argc, argv, 3, 50000, userCount) ||
+            !numericArg(argc, argv, 4, std::max(1u, std::thread::hardware_concurrency()), maxThreads)) {
+            return 1;
+        }
+        return runLoadBenchmark(bookCount, userCount, std::max<size_t>(1, maxThreads)) ? 0 : 1;
+    }
+
+    if (mode == "--bench-txn") {
+        size_t maxThreads;
+        if (!numericArg(argc, argv, 2, 8, maxThreads)) return 1;
+        return runTransactionBenchmark(std::max<size_t>(1, maxThreads)) ? 0 : 1;
+    }
+
+    if (mode == "--bench-snapshot") {
+        size_t bookCount, maxReaders;
+        if (!numericArg(argc, argv, 2, 200000, bookCount) || !numericArg(argc, argv, 3, 4, maxReaders)) return 1;
+        return runSnapshotBenchmark(std::max<size_t>(2, bookCount), maxReaders) ? 0 : 1;
+    }
+
+    if (mode == "--bench-login") {
+        runLoginBenchmark();
+        return 0;
+    }
+#endif
+
+#ifdef __linux__
+    if (mode == "--serve") {
+        size_t flushMs;
+        if (!numericArg(argc, argv, 3, 0, flushMs)) return 1;
+        try {
+            LibrarySystem library;
+            if (argc > 3) library.setFlushInterval(std::chrono::milliseconds(flushMs));
+            LibraryServer server(library, argc > 2 ? argv[2] : "library.sock");
+            if (!server.start()) return 1;
+            server.run();
+            return 0;
+        } catch (const std::exception& e) {
+            std::cout << "Fatal error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (mode == "--loadgen") {
+        if (argc < 4) {
+            std::cout << "Usage: " << argv[0]
+                      << " --loadgen <connections> <requestsPerConnection> [depth] [library.sock]" << std::endl;
+            return 1;
+        }
+        size_t connections, requests, depth;
+        if (!numericArg(argc, argv, 2, 0, connections) || !numericArg(argc, argv, 3, 0, requests) ||
+            !numericArg(argc, argv, 4, 1, depth)) {
+            return 1;
+        }
+        return runLoadGenerator(connections, requests, std::max<size_t>(1, depth),
+                                argc > 5 ? argv[5] : "library.sock") ? 0 : 1;
+    }
+#endif
+
     try {
         LibrarySystem library;
         library.run();